@@ -1179,7 +1179,10 @@ static int validate_wait(const struct parse_node *const stmt,
 
     char wait_variant;
 
-    switch (stmt->nchildren) {
+    /* the quaints of a wait-any and everything after them are one child further */
+    const uint8_t any = parse_node_is_tk(stmt->children[1]);
+
+    switch (stmt->nchildren - any) {
     case 3:
         wait_variant = wait_expr;
         break;
@@ -1189,13 +1192,13 @@ static int validate_wait(const struct parse_node *const stmt,
         break;
 
     case 5:
-        wait_variant = parse_node_tk(stmt->children[2]) == LEX_TK_WFOR ?
+        wait_variant = parse_node_tk(stmt->children[2 + any]) == LEX_TK_WFOR ?
             wait_expr_wfor_expr : wait_expr_wunt_expr;
 
         break;
 
     case 6:
-        wait_variant = parse_node_tk(stmt->children[2]) == LEX_TK_WFOR ?
+        wait_variant = parse_node_tk(stmt->children[2 + any]) == LEX_TK_WFOR ?
             wait_expr_wfor_expr_wnob : wait_expr_wunt_expr_wnob;
 
         break;
@@ -1208,9 +1211,11 @@ static int validate_wait(const struct parse_node *const stmt,
     }
 
     struct ast_wait *const ast_wait = ast_data(*ast, wait);
+    ast_wait->any = any;
+    ast_wait->spawn = parse_node_tk(stmt->children[0]) == LEX_TK_SPWN;
     int error;
 
-    if ((error = validate_expr(stmt->children[1], &ast_wait->wquaint, *ast))) {
+    if ((error = validate_expr(stmt->children[1 + any], &ast_wait->wquaint, *ast))) {
         return ast_destroy(ast_wait->wquaint), error;
     }
 
@@ -1222,7 +1227,7 @@ static int validate_wait(const struct parse_node *const stmt,
 
     case wait_expr_wfor_expr:
     case wait_expr_wfor_expr_wnob: {
-        const struct parse_node *expr = stmt->children[3];
+        const struct parse_node *expr = stmt->children[3 + any];
 
         if (expr_is(PARSE_NT_Wexp, expr)) {
             ast_wait->units =
@@ -1240,7 +1245,7 @@ static int validate_wait(const struct parse_node *const stmt,
 
     case wait_expr_wunt_expr:
     case wait_expr_wunt_expr_wnob: {
-        const struct parse_node *expr = stmt->children[3];
+        const struct parse_node *expr = stmt->children[3 + any];
 
         if ((error = validate_expr(expr, &ast_wait->wunt, *ast))) {
             return ast_destroy(ast_wait->wunt), error;
@@ -1574,6 +1579,14 @@ static int validate_stmt(const struct parse_node *const stmt,
             return validate_wait(stmt, ast, parent);
         }
 
+        case LEX_TK_SPWN: {
+            if (ctx == CTX_UNIT) {
+                return INVALID("spawn statement in unit context", stmt);
+            }
+
+            return validate_wait(stmt, ast, parent);
+        }
+
         case LEX_TK_RETN: {
             if (ctx == CTX_UNIT) {
                 return INVALID("return statement in unit context", stmt);
@@ -2112,7 +2125,9 @@ void ast_print(FILE *const out, const struct ast_node *const ast, const int leve
 
     case AST_AN_WAIT: {
         const struct ast_wait *const wait = ast_data(ast, wait);
-        print(YELLOW("wait ") WHITE("%s\n"), wait->noblock ? "noblock" : "");
+        print(YELLOW("%s ") WHITE("%s%s\n"), wait->spawn ? "spawn" : "wait",
+            wait->any ? "any " : "", wait->noblock ? "noblock" : "");
+
         ast_print(out, wait->wquaint, level + 1);
 
         if (wait->wfor) {
@@ -132,7 +132,7 @@ struct ast_retn {
 
 struct ast_wait {
     struct ast_node *wquaint, *wfor, *wunt;
-    uint8_t noblock: 1, units: 1;
+    uint8_t noblock: 1, units: 1, any: 1, spawn: 1;
 
     /* wunt != NULL */
     const struct ast_func *func;
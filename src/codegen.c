@@ -56,7 +56,7 @@
                 temp_off_peak = temp_off; \
             } \
             \
-            begin_temp_off; \
+            temp_base + begin_temp_off; \
         }), \
         .size = (_size), \
     }
@@ -144,12 +144,12 @@
         .qat = { (_dst), (_quaint), (_func), (_wlab_id) } \
     }
 
-#define INSN_WAIT(_quaint, _timeout, _func, _wlab_id, _noblock, _units, _has_timeout) \
+#define INSN_WAIT(_quaint, _timeout, _func, _wlab_id, _noblock, _units, _has_timeout, _any, _spawn) \
     RESERVE_INSN o->insns[ip++] = (struct codegen_insn) { \
         .op = CODEGEN_OP_WAIT, \
         .wait = { \
             (_quaint), (_timeout), (_func), (_wlab_id), \
-            (_noblock), (_units), (_has_timeout) \
+            (_noblock), (_units), (_has_timeout), (_any), (_spawn) \
         } \
     }
 
@@ -195,10 +195,10 @@
         .call = { .val = (_val), .loc = (_loc), .bp = (_bp) } \
     }
 
-#define INSN_INCSP(_addend, _tsize) \
+#define INSN_INCSP(_addend, _tsize, _stack) \
     RESERVE_INSN o->insns[ip++] = (struct codegen_insn) { \
         .op = CODEGEN_OP_INCSP, \
-        .incsp = { .addend = (_addend), .tsize = (_tsize) } \
+        .incsp = { .addend = (_addend), .tsize = (_tsize), .stack = (_stack) } \
     }
 
 #define INSN_RET(_size) \
@@ -220,14 +220,39 @@
 
 static size_t insn_size, strings_mem_size, ip, temp_off, temp_off_peak;
 
+/*
+ * Unless built with CODEGEN_HEAP_TEMPS, the temporaries of a function are laid
+ * out in its frame right above the autos, so that they are addressed like them.
+ */
+static size_t temp_base;
+
+/* how much the calls and quaints being generated have pushed on the stack */
+static size_t push_depth;
+
 struct ofs {
     size_t off, size;
 };
 
+/* a call of a function whose frame starts `depth` bytes above the caller's */
+struct call_site {
+    const struct ast_node *func;
+    size_t depth;
+};
+
+/*
+ * The stack a call of a function needs from the start of its frame: the frame,
+ * the temporaries in it and the deepest of the calls it makes. It is unknown
+ * (0) for a function which calls through a function pointer or recursively.
+ */
 struct func_tag {
     size_t frame_size, args_size;
     uint64_t loc;
     struct htab *layout;
+
+    size_t stack_size, temps_size, push_peak;
+    struct call_site *calls;
+    size_t call_count, call_size;
+    uint8_t unbounded: 1, visiting: 1, visited: 1;
 };
 
 static struct htab *globals, *funcs;
@@ -246,6 +271,7 @@ static void funcs_dtor(const void *const ptr)
 {
     const struct func_tag *const tag = ptr;
     htab_destroy(tag->layout, htab_default_dtor);
+    free(tag->calls);
     free((void *) tag);
 }
 
@@ -495,7 +521,7 @@ static int create_global_and_frame_layouts(const struct ast_node *const root,
         } break;
 
         case AST_AN_FUNC: {
-            struct func_tag *const tag = malloc(sizeof(struct func_tag));
+            struct func_tag *const tag = calloc(1, sizeof(struct func_tag));
 
             if (unlikely(!tag)) {
                 goto out_nomem;
@@ -569,6 +595,91 @@ static int push_string(const uint8_t *const beg, const uint8_t *const end)
     return CODEGEN_OK;
 }
 
+static size_t pushed_size(const struct codegen_opd *const opd)
+{
+    size_t size = opd->opd == CODEGEN_OPD_IMM ? (opd->immsize ? opd->immsize : 8) : opd->size;
+    ALIGN_UP(size, 8);
+    return size;
+}
+
+/*
+ * `loc` is what is called: a function, a built-in one or a function pointer,
+ * and `depth` where the frame of the call starts.
+ */
+static int add_call_site(const struct codegen_opd *const loc, const size_t depth)
+{
+    if (loc->opd != CODEGEN_OPD_IMM) {
+        ftag->unbounded = 1;
+        return CODEGEN_OK;
+    }
+
+    if (loc->immsize) {
+        if (push_depth > ftag->push_peak) {
+            ftag->push_peak = push_depth;
+        }
+
+        return CODEGEN_OK;
+    }
+
+    if (ftag->call_count == ftag->call_size) {
+        const size_t new_call_size = ftag->call_size ? ftag->call_size * 2 : 4;
+
+        struct call_site *const tmp = realloc(ftag->calls,
+            new_call_size * sizeof(struct call_site));
+
+        if (unlikely(!tmp)) {
+            return CODEGEN_NOMEM;
+        }
+
+        ftag->calls = tmp;
+        ftag->call_size = new_call_size;
+    }
+
+    ftag->calls[ftag->call_count++] = (struct call_site) {
+        .func = (const struct ast_node *) (uintptr_t) loc->imm,
+        .depth = depth,
+    };
+
+    return CODEGEN_OK;
+}
+
+/* 0 if unknown */
+static size_t analyse_stack_size(struct func_tag *const tag)
+{
+    if (tag->visited) {
+        return tag->stack_size;
+    }
+
+    if (tag->visiting) {
+        tag->unbounded = 1;
+        return 0;
+    }
+
+    tag->visiting = 1;
+    size_t deepest = tag->push_peak;
+
+    for (size_t idx = 0; idx < tag->call_count; ++idx) {
+        struct func_tag *const callee = htab_get(funcs, (uintptr_t) tag->calls[idx].func);
+        const size_t callee_size = analyse_stack_size(callee);
+
+        if (!callee_size) {
+            tag->unbounded = 1;
+            break;
+        }
+
+        const size_t depth = tag->calls[idx].depth + callee_size;
+
+        if (depth > deepest) {
+            deepest = depth;
+        }
+    }
+
+    tag->visiting = 0;
+    tag->visited = 1;
+    tag->stack_size = tag->unbounded ? 0 : tag->frame_size + tag->temps_size + deepest;
+    return tag->stack_size;
+}
+
 static int gen_blok(const struct ast_node *);
 static int gen_stmt(const struct ast_node *);
 static int gen_expr(const struct ast_node *, struct codegen_opd *, bool);
@@ -969,6 +1080,7 @@ static int gen_uexp_tild(const struct ast_node *const expr,
         const struct ast_node *arglist = fexp->rhs;
         OPD_TEMP(ssp, 0, 8);
         INSN_DST(GETSP, ssp);
+        const size_t saved_push_depth = push_depth;
 
         while (arglist) {
             const uint8_t not_last = arglist->an == AST_AN_BEXP &&
@@ -982,11 +1094,18 @@ static int gen_uexp_tild(const struct ast_node *const expr,
             struct codegen_opd arg_res;
             GEN_EXPR(arg, &arg_res, false);
             INSN_PUSH(arg_res);
+            push_depth += pushed_size(&arg_res);
         }
 
         struct codegen_opd lhs_res;
         GEN_EXPR(fexp->lhs, &lhs_res, false);
         INSN_QNT(dst, lhs_res, ssp);
+
+        if (push_depth > ftag->push_peak) {
+            ftag->push_peak = push_depth;
+        }
+
+        push_depth = saved_push_depth;
     } else {
         struct codegen_opd res;
         GEN_EXPR(uexp->rhs, &res, false);
@@ -1122,7 +1241,9 @@ static int gen_fexp(const struct ast_node *const expr,
     OPD_IMM(addr, 0, 0, 8);
     OPD_TEMP(ssp, 0, 8);
     const size_t pushr_ip = ip;
+    const size_t saved_push_depth = push_depth;
     INSN_PUSHR(addr, ssp);
+    push_depth += 16;
 
     const struct ast_node *arglist = fexp->rhs;
 
@@ -1140,12 +1261,19 @@ static int gen_fexp(const struct ast_node *const expr,
         struct codegen_opd arg_res;
         GEN_EXPR(arg, &arg_res, false);
         INSN_PUSH(arg_res);
+        push_depth += pushed_size(&arg_res);
     }
 
     struct codegen_opd lhs_res;
     GEN_EXPR(fexp->lhs, &lhs_res, false);
     o->insns[pushr_ip].push.val.imm = ip;
 
+    if (unlikely(add_call_site(&lhs_res, saved_push_depth + 16))) {
+        return CODEGEN_NOMEM;
+    }
+
+    push_depth = saved_push_depth;
+
     if (size) {
         OPD_TEMP(val, signd, size);
         INSN_CALLV(val, lhs_res, ssp);
@@ -1605,7 +1733,42 @@ static int gen_wait(const struct ast_node *const stmt)
     const struct ast_wait *const wait = ast_data(stmt, wait);
 
     struct codegen_opd res_quaint;
-    GEN_EXPR(wait->wquaint, &res_quaint, false);
+
+    if (wait->any) {
+        /*
+         * The quaints of a wait-any are pushed on the stack, where the wait
+         * finds them between the saved stack pointer and the current one.
+         */
+        OPD_TEMP(ssp, 0, 8);
+        INSN_DST(GETSP, ssp);
+        const size_t saved_push_depth = push_depth;
+        const struct ast_node *wlist = wait->wquaint;
+
+        while (wlist) {
+            const uint8_t not_last = wlist->an == AST_AN_BEXP &&
+                ast_data(wlist, bexp)->op == LEX_TK_COMA;
+
+            const struct ast_node *const wquaint = not_last ?
+                ast_data(wlist, bexp)->lhs : wlist;
+
+            wlist = not_last ? ast_data(wlist, bexp)->rhs : NULL;
+
+            struct codegen_opd res;
+            GEN_EXPR(wquaint, &res, false);
+            INSN_PUSH(res);
+            push_depth += pushed_size(&res);
+        }
+
+        if (push_depth > ftag->push_peak) {
+            ftag->push_peak = push_depth;
+        }
+
+        push_depth = saved_push_depth;
+        res_quaint = ssp;
+    } else {
+        GEN_EXPR(wait->wquaint, &res_quaint, false);
+    }
+
     OPD_IMM(res_timeout, 0, 0, 1);
 
     if (wait->wfor) {
@@ -1617,7 +1780,7 @@ static int gen_wait(const struct ast_node *const stmt)
         wait->func->wlabs[wait->wlab_idx].id : 0;
 
     INSN_WAIT(res_quaint, res_timeout, func, wlab_id,
-        wait->noblock, wait->units, wait->wfor ? 1 : 0);
+        wait->noblock, wait->units, wait->wfor ? 1 : 0, wait->any, wait->spawn);
 
     return CODEGEN_OK;
 }
@@ -1687,16 +1850,38 @@ static int gen_func(const struct ast_node *const node)
     const size_t incsp_ip = ip;
     OPD_IMM(addend, 0, ftag->frame_size - ftag->args_size, 8);
     OPD_IMM(tsize, 0, 0, 8);
-    INSN_INCSP(addend, tsize);
+    OPD_IMM(stack, 0, 0, 8);
+    INSN_INCSP(addend, tsize, stack);
 
     temp_off_peak = 0;
+#ifndef CODEGEN_HEAP_TEMPS
+    temp_base = ftag->frame_size;
+#endif
 
     for (size_t idx = 0; idx < func->stmt_count; ++idx) {
         GEN_STMT(func->stmts[idx]);
     }
 
+#ifdef CODEGEN_HEAP_TEMPS
     o->insns[incsp_ip].incsp.tsize.imm = temp_off_peak;
-    OPD_IMM(size, 0, ftag->frame_size + 16, 8);
+    const size_t temps_size = 0;
+#else
+    size_t temps_size = temp_off_peak;
+    ALIGN_UP(temps_size, 8);
+    o->insns[incsp_ip].incsp.addend.imm += temps_size;
+
+    /* the returns have been generated before the size of the temporaries was known */
+    for (size_t idx = incsp_ip; idx < ip; ++idx) {
+        if (o->insns[idx].op == CODEGEN_OP_RET || o->insns[idx].op == CODEGEN_OP_RETV) {
+            o->insns[idx].ret.size.imm += temps_size;
+        }
+    }
+
+    temp_base = 0;
+#endif
+
+    ftag->temps_size = temps_size;
+    OPD_IMM(size, 0, ftag->frame_size + temps_size + 16, 8);
     INSN_RET(size);
     ftag = NULL;
     return CODEGEN_OK;
@@ -1876,8 +2061,8 @@ static void print_insns(void)
             print_opd(&insn->wait.quaint);
             print_opd(&insn->wait.timeout);
             printf("%" PRIxPTR ":%" PRIu64, insn->wait.func, insn->wait.wlab_id);
-            printf(" %u:%u:%u",
-                insn->wait.noblock, insn->wait.units, insn->wait.has_timeout);
+            printf(" %u:%u:%u:%u:%u", insn->wait.noblock, insn->wait.units,
+                insn->wait.has_timeout, insn->wait.any, insn->wait.spawn);
             break;
 
         case CODEGEN_OP_WLAB:
@@ -1925,6 +2110,7 @@ static void print_insns(void)
         case CODEGEN_OP_INCSP:
             print_opd(&insn->incsp.addend);
             print_opd(&insn->incsp.tsize);
+            print_opd(&insn->incsp.stack);
             break;
 
         case CODEGEN_OP_RET:
@@ -1953,7 +2139,7 @@ int codegen_obj_create(const struct ast_node *const root,
     obj->strings.size = 0;
 
     o = obj;
-    insn_size = strings_mem_size = ip = temp_off = 0;
+    insn_size = strings_mem_size = ip = temp_off = temp_base = 0;
 
     size_t decl_count, func_count;
     count_top_decls_and_funcs(root, &decl_count, &func_count);
@@ -1994,6 +2180,14 @@ int codegen_obj_create(const struct ast_node *const root,
         }
     }
 
+    /* the size of the stack a quaint of each function needs, if it is known */
+    for (size_t idx = 0; idx < unit->stmt_count; ++idx) {
+        if (unit->stmts[idx]->an == AST_AN_FUNC) {
+            struct func_tag *const tag = htab_get(funcs, (uintptr_t) unit->stmts[idx]);
+            o->insns[tag->loc].incsp.stack.imm = analyse_stack_size(tag);
+        }
+    }
+
     o->insn_count = ip;
     print_insns();
 
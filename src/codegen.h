@@ -135,7 +135,7 @@ struct codegen_insn {
             struct codegen_opd quaint, timeout;
             uintptr_t func;
             uint64_t wlab_id;
-            uint8_t noblock: 1, units: 1, has_timeout: 1;
+            uint8_t noblock: 1, units: 1, has_timeout: 1, any: 1, spawn: 1;
         } wait;
 
         struct {
@@ -157,7 +157,7 @@ struct codegen_insn {
         } call;
 
         struct {
-            struct codegen_opd addend, tsize;
+            struct codegen_opd addend, tsize, stack;
         } incsp;
 
         struct {
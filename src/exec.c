@@ -1,3 +1,7 @@
+#ifdef EXEC_MMAP_STACKS
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS, MAP_NORESERVE */
+#endif
+
 #include "exec.h"
 
 #include "codegen.h"
@@ -13,6 +17,27 @@
 #include <time.h>
 #include <assert.h>
 #include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <limits.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#ifdef EXEC_TASKS
+#include <pthread.h>
+#endif
+
+#if defined(EXEC_MMAP_STACKS) && !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
 
 /* OS X doesn't have clock_gettime(), define a drop-in replacement */
 #if defined(__MACH__) && !defined(CLOCK_MONOTONIC)
@@ -58,64 +83,402 @@ static int get_monotonic_time(uint64_t *const value)
     return 0;
 }
 
-#define LEGAL_IF(cond, msg, ...) \
+/* computed goto is a GNU extension, other compilers get a switch loop */
+#if defined(__GNUC__) && !defined(EXEC_SWITCH_DISPATCH)
+#define EXEC_THREADED
+#endif
+
+#define LEGAL_AT(ip, cond, msg, ...) \
     if (unlikely(!(cond))) { \
         fprintf(stderr, "%s:%d: illegal instruction at %" PRIu64 ": ", \
-            __FILE__, __LINE__, vm->ip); \
+            __FILE__, __LINE__, (uint64_t) (ip)); \
         \
         fputs(#cond, stderr); \
         fprintf(stderr, ": " msg "\n", ## __VA_ARGS__); \
         return EXEC_ILLEGAL; \
     }
 
-static uint64_t now;
+#define LEGAL_IF(cond, msg, ...) LEGAL_AT(vm->ip, cond, msg, ## __VA_ARGS__)
+
+/*
+ * Checks of the machine state which only a corrupted stack or a wrong
+ * codegen could violate. The unsafe build trusts the verified program and
+ * leaves them out, stack overflows are checked in either mode.
+ */
+#ifdef EXEC_UNSAFE
+#define SAFE_LEGAL_IF(cond, msg, ...) ((void) 0)
+#else
+#define SAFE_LEGAL_IF(cond, msg, ...) LEGAL_IF(cond, msg, ## __VA_ARGS__)
+#endif
+
+/*
+ * With EXEC_TASKS, spawned quaints run on a pool of threads, each with its own
+ * running VM, clock, timer state, reactor and VM pool. The program itself and
+ * the data segment are shared, see the tasks below.
+ */
+#ifdef EXEC_TASKS
+#define TASK_LOCAL _Thread_local
+#else
+#define TASK_LOCAL
+#endif
+
+#if defined(EXEC_TASKS) && defined(EXEC_RECLAIM)
+#error "the ownership of quaints is not tracked across threads"
+#endif
+
+static TASK_LOCAL uint64_t now;
 static uint8_t *bss;
 static uint64_t bss_size;
 
+#ifdef CODEGEN_HEAP_TEMPS
+/*
+ * The temporaries of the calls of a VM are bump-allocated from a list of
+ * chunks, which are kept for reuse once allocated. Otherwise they are part of
+ * the frames of the calls.
+ */
+struct tmp_chunk {
+    struct tmp_chunk *next;
+    uint64_t top, size;
+    uint8_t mem[] __attribute__((aligned(8)));
+};
+
 struct tmp_frame {
     struct tmp_frame *prev;
-    uint8_t mem[];
+    struct tmp_chunk *chunk; /* the current chunk before the push */
+    uint64_t top;
+    uint8_t mem[] __attribute__((aligned(8)));
 };
 
+#define TMP_CHUNK_SIZE (4096 - sizeof(struct tmp_chunk))
+#endif
+
+/*
+ * With EXEC_MMAP_STACKS, every VM is a mapping of EXEC_STACK_RESERVE bytes of
+ * address space ending in a guard page, whose pages are only committed when
+ * they are touched. Otherwise it is a small heap block. Either way, the size
+ * of the stack of a VM is recorded in it and STACK_SIZE is only a bound.
+ */
+#ifdef EXEC_MMAP_STACKS
+#ifndef EXEC_STACK_RESERVE
+#define EXEC_STACK_RESERVE (sizeof(void *) == 8 ? 8 * 1024 * 1024 : 256 * 1024)
+#endif
+
+#define STACK_SIZE (EXEC_STACK_RESERVE - sizeof(struct qvm))
+#else
 #define STACK_SIZE (4096 * 4 - sizeof(struct qvm))
+#endif
+
+/*
+ * The program is not executed in the form codegen emits it, but in a dense
+ * copy made by encode(): an operand takes a 32-bit offset and a size field
+ * instead of two 64-bit words, immediates and wait labels are kept in pools
+ * on the side, and the instruction is no larger than its largest operands.
+ */
+struct exec_opd {
+    uint32_t off; /* the index in the immediate pool for CODEGEN_OPD_IMM */
+    uint32_t opd: 2, signd: 1, indirect: 1, size: 28;
+};
+
+#define EXEC_OPD_SIZE_MAX ((UINT32_C(1) << 28) - 1)
+
+typedef uint16_t exec_op_t;
+
+struct exec_insn {
+    codegen_op_t op;
+    exec_op_t quick; /* the handler, see quicken() */
+
+    union {
+        struct {
+            struct exec_opd dst, src1, src2;
+        } bin;
+
+        struct {
+            struct exec_opd dst, src;
+        } un;
+
+        struct exec_opd dst;
+
+        struct {
+            struct exec_opd dst, loc, sp;
+        } qnt;
+
+        struct {
+            struct exec_opd dst, val;
+        } qntv;
+
+        struct {
+            struct exec_opd dst, quaint;
+            uint32_t label;
+        } qat;
+
+        struct {
+            struct exec_opd quaint, timeout;
+            uint32_t label;
+            uint8_t noblock: 1, units: 1, has_timeout: 1, any: 1, spawn: 1;
+        } wait;
+
+        struct {
+            uint32_t label;
+        } wlab;
+
+        struct {
+            struct exec_opd cond;
+            uint32_t loc;
+        } jmp;
+
+        struct {
+            struct exec_opd val, ssp;
+        } push;
+
+        struct {
+            struct exec_opd val, loc, bp;
+        } call;
+
+        struct {
+            struct exec_opd addend, tsize, stack;
+        } incsp;
+
+        struct {
+            struct exec_opd val, size;
+        } ret;
+    };
+};
+
+static_assert(sizeof(struct exec_insn) == 28, "");
+
+/* the labels are deduplicated, so that they compare by their index */
+struct exec_label {
+    uintptr_t func;
+    uint64_t id;
+};
+
+static struct exec_insn *insns;
+static uint64_t *imms;
+static struct exec_label *labels;
+static size_t imm_count, label_count;
 
 struct qvm {
     struct qvm *parent;
     uint64_t ip, sp, bp;
+    uint64_t stack_size;
     uint64_t at_start: 1, at_end: 1, noint: 1,
-        waiting: 1, waiting_for: 1, waiting_until: 1, waiting_noblock: 1;
+        waiting: 1, waiting_for: 1, waiting_until: 1, waiting_noblock: 1,
+        waiting_any: 1,
+        may_split: 1, /* an ancestor waits for a wait label or runs a wait-any */
+        parked: 1; /* it or a quaint it waits for waits for park_fd to be ready */
 
     union {
         struct {
             uint64_t start, interval;
         } wait_for;
 
-        struct {
-            uintptr_t func;
-            uint64_t id;
-        } wait_until;
+        uint32_t wait_until;
     };
 
-    struct {
-        uintptr_t func;
-        uint64_t id;
-    } last_passed;
+    uint32_t last_passed;
+
+    /*
+     * A wait-any runs the quaints on top of the stack in turns of any_slice
+     * safepoints, any_current being the one running. The index of the quaint
+     * that completed, or any_count if none did, is left in waited.
+     */
+    uint32_t any_count, any_current, any_slice, waited;
 
+    struct qvm *park_next;
+    int32_t park_fd;
+    int16_t park_events;
+
+#ifdef EXEC_TASKS
+    uint32_t task; /* TASK_SPAWNED or TASK_DONE once spawned, read atomically */
+#endif
+
+#ifdef CODEGEN_HEAP_TEMPS
     struct tmp_frame *temps;
+    struct tmp_chunk *tmp_chunks, *tmp_chunk;
+#endif
+
+#ifdef EXEC_RECLAIM
+    struct qvm *owner, *children, *older, *newer; /* see reclaim() */
+    struct qvm *prev_live, *next_live;
+    uint64_t owner_bp;
+    bool held, scanned;
+#endif
+
     uint8_t stack[] __attribute__((aligned(8)));
 };
 
-static struct qvm *vm;
+static TASK_LOCAL struct qvm *vm;
 static const struct codegen_obj *o;
 
-static uint64_t opd_size(const struct codegen_opd *const operand)
+/*
+ * The lowest and the highest address of the memory allocated for the program
+ * and its quaints, for a checkpoint to tell which words may point into it.
+ */
+static uintptr_t heap_low = UINTPTR_MAX, heap_high;
+
+static void note_heap(const void *const mem, const uint64_t size)
+{
+    const uintptr_t low = (uintptr_t) mem, high = low + (uintptr_t) size;
+
+    if (!mem) {
+        return;
+    }
+
+#ifdef EXEC_TASKS
+    uintptr_t old = __atomic_load_n(&heap_low, __ATOMIC_RELAXED);
+
+    while (low < old && !__atomic_compare_exchange_n(&heap_low, &old, low, true,
+        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+
+    old = __atomic_load_n(&heap_high, __ATOMIC_RELAXED);
+
+    while (high > old && !__atomic_compare_exchange_n(&heap_high, &old, high, true,
+        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+#else
+    if (low < heap_low) {
+        heap_low = low;
+    }
+
+    if (high > heap_high) {
+        heap_high = high;
+    }
+#endif
+}
+
+/*
+ * The memory the program allocates itself, including the boxes of quaints of
+ * values. A VM built with RECLAIM=1 keeps all of it on a list, since quaint
+ * handles may be stored there (see reclaim()).
+ */
+#ifdef EXEC_RECLAIM
+struct heap_block {
+    struct heap_block *prev, *next;
+    uint64_t size, pad;
+};
+
+static struct heap_block heap_blocks = { &heap_blocks, &heap_blocks, 0, 0 };
+
+static void link_block(struct heap_block *const block, const uint64_t size)
+{
+    block->size = size;
+    block->prev = &heap_blocks;
+    block->next = heap_blocks.next;
+    heap_blocks.next->prev = block;
+    heap_blocks.next = block;
+}
+
+static void unlink_block(struct heap_block *const block)
+{
+    block->prev->next = block->next;
+    block->next->prev = block->prev;
+}
+
+static void *heap_alloc(const uint64_t size, const bool zero)
+{
+    if (unlikely(size > SIZE_MAX - sizeof(struct heap_block))) {
+        return NULL;
+    }
+
+    const size_t total = sizeof(struct heap_block) + (size_t) size;
+    struct heap_block *const block = zero ? calloc(1, total) : malloc(total);
+
+    if (unlikely(!block)) {
+        return NULL;
+    }
+
+    link_block(block, size);
+    note_heap(block + 1, size);
+    return block + 1;
+}
+
+static void *heap_realloc(void *const mem, const uint64_t size)
+{
+    if (!mem) {
+        return heap_alloc(size, false);
+    }
+
+    if (unlikely(size > SIZE_MAX - sizeof(struct heap_block))) {
+        return NULL;
+    }
+
+    struct heap_block *const old = (struct heap_block *) mem - 1;
+    unlink_block(old);
+    struct heap_block *const block = realloc(old, sizeof(struct heap_block) + (size_t) size);
+
+    if (unlikely(!block)) {
+        link_block(old, old->size);
+        return NULL;
+    }
+
+    link_block(block, size);
+    note_heap(block + 1, size);
+    return block + 1;
+}
+
+static void heap_free(void *const mem)
+{
+    if (mem) {
+        struct heap_block *const block = (struct heap_block *) mem - 1;
+        unlink_block(block);
+        free(block);
+    }
+}
+#else
+static void *heap_alloc(const uint64_t size, const bool zero)
+{
+    void *const mem = zero ? calloc(1, (size_t) size) : malloc((size_t) size);
+    note_heap(mem, size);
+    return mem;
+}
+
+static void *heap_realloc(void *const mem, const uint64_t size)
+{
+    void *const grown = realloc(mem, (size_t) size);
+    note_heap(grown, size);
+    return grown;
+}
+
+static void heap_free(void *const mem)
+{
+    free(mem);
+}
+#endif
+
+/*
+ * A quaint of a value (~expr) is not a VM: its handle is tagged in the low
+ * bits, which are clear in the address of a VM. A value of up to 4 bytes is
+ * held in the upper half of the handle itself, a larger one in a heap block
+ * of its size. Such a quaint is both at its start and at its end.
+ */
+#define QVAL_INLINE UINT64_C(1)
+#define QVAL_BOXED  UINT64_C(2)
+#define QVAL_MASK   UINT64_C(3)
+
+static void qval_get(const uint64_t handle, void *const dst, const uint64_t size)
+{
+    if ((handle & QVAL_MASK) == QVAL_INLINE) {
+        const uint32_t bits = (uint32_t) (handle >> 32);
+        memcpy(dst, &bits, (size_t) size);
+    } else {
+        memcpy(dst, (const void *) (uintptr_t) (handle & ~QVAL_MASK), (size_t) size);
+    }
+}
+
+static void qval_free(const uint64_t handle)
+{
+    if ((handle & QVAL_MASK) == QVAL_BOXED) {
+        heap_free((void *) (uintptr_t) (handle & ~QVAL_MASK));
+    }
+}
+
+static uint64_t opd_size(const struct exec_opd *const operand)
 {
     switch (operand->opd) {
     case CODEGEN_OPD_IMM:
         assert(operand->signd == 0);
         assert(operand->indirect == 0);
-        assert(powerof2(operand->immsize) && operand->immsize <= 8);
-        return operand->immsize;
+        assert(powerof2((uint32_t) operand->size) && operand->size <= 8);
+        return operand->size;
 
     case CODEGEN_OPD_TEMP:
     case CODEGEN_OPD_AUTO:
@@ -127,22 +490,26 @@ static uint64_t opd_size(const struct codegen_opd *const operand)
     }
 }
 
-static void *opd_val(const struct codegen_opd *const operand)
+static void *opd_val(const struct exec_opd *const operand)
 {
     void *base;
 
     switch (operand->opd) {
     case CODEGEN_OPD_IMM:
-        return (void *) &operand->imm;
+        return &imms[operand->off];
 
+#ifdef CODEGEN_HEAP_TEMPS
     case CODEGEN_OPD_TEMP: {
         assert(vm->temps != NULL);
         assert(vm->temps->mem != NULL);
         base = vm->temps->mem + operand->off;
     } break;
+#else
+    case CODEGEN_OPD_TEMP:
+#endif
 
     case CODEGEN_OPD_AUTO: {
-        assert(vm->bp + operand->off < STACK_SIZE);
+        assert(vm->bp + operand->off < vm->stack_size);
         base = vm->stack + vm->bp + operand->off;
     } break;
 
@@ -167,7 +534,7 @@ static void *opd_val(const struct codegen_opd *const operand)
     }
 }
 
-static int exit_status_from_retval(const struct codegen_insn *const insn)
+static int exit_status_from_retval(const struct exec_insn *const insn)
 {
     const uint8_t val_signd = insn->ret.val.signd;
     const uint64_t val_size = opd_size(&insn->ret.val);
@@ -183,1504 +550,5393 @@ static int exit_status_from_retval(const struct codegen_insn *const insn)
     return 0;
 }
 
-static void check_and_eventually_split_vms(void)
+/*
+ * Timed waits: the earliest deadline of the waiting VMs is armed as a
+ * one-shot interval timer, whose signal only raises a flag for the next
+ * safepoint to read the clock and see which VM is due.
+ */
+static TASK_LOCAL volatile sig_atomic_t deadline_passed;
+static TASK_LOCAL uint64_t armed_deadline; /* 0 if the timer is not armed */
+static TASK_LOCAL bool deadline_blocked; /* a deadline passed inside a noint block */
+
+#ifdef EXEC_TASKS
+static TASK_LOCAL uint32_t task_self; /* the index of the thread, 0 for the main one */
+#endif
+
+static void deadline_handler(const int signum)
 {
-    static uint64_t cycles;
+    (void) signum;
+    deadline_passed = 1;
+}
 
-    if (cycles++ % 200 == 0 && get_monotonic_time(&now)) {
-        return;
+/* arms the timer for the given deadline, or disarms it for 0 */
+static int arm_deadline(const uint64_t deadline)
+{
+    struct itimerval itv = { .it_interval = { 0, 0 }, .it_value = { 0, 0 } };
+
+#ifdef EXEC_TASKS
+    /* only the main thread takes the signal, the others read the clock at every safepoint */
+    if (task_self) {
+        armed_deadline = deadline;
+        deadline_passed = deadline != 0;
+        return 0;
     }
+#endif
 
-    uint8_t noint = vm->noint;
-    struct qvm *old_vm = vm, *current_vm = vm->parent;
+    if (deadline) {
+        /* rounded up, a zero value would disarm the timer */
+        const uint64_t left = deadline > now ? (deadline - now + 999) / 1000 : 1;
+        itv.it_value.tv_sec = (time_t) (left / 1000000);
+        itv.it_value.tv_usec = (suseconds_t) (left % 1000000);
+    }
 
-    while (current_vm && !noint) {
-        bool split = false;
+    if (unlikely(setitimer(ITIMER_REAL, &itv, NULL))) {
+        return perror("setitimer"), -1;
+    }
 
-        if (current_vm->waiting) {
-            if (current_vm->waiting_for) {
-                split = now - current_vm->wait_for.start >= current_vm->wait_for.interval;
-            } else if (current_vm->waiting_until) {
-                split = old_vm->last_passed.func == current_vm->wait_until.func &&
-                    old_vm->last_passed.id == current_vm->wait_until.id;
-            }
-        }
+    armed_deadline = deadline;
+    return 0;
+}
 
-        if (split) {
-            vm = current_vm;
-            vm->waiting = 0;
-            vm->waiting_for = 0;
-            vm->waiting_until = 0;
-            vm->waiting_noblock = 0;
-            vm->ip++;
-            return;
-        }
+/* arms the timer for the earliest deadline still to come above the VM */
+static void arm_next_deadline(const struct qvm *qvm)
+{
+    uint64_t next = 0;
 
-        noint = current_vm->noint;
-        old_vm = current_vm;
-        current_vm = current_vm->parent;
+    for (qvm = qvm->parent; qvm; qvm = qvm->parent) {
+        if (qvm->waiting && qvm->waiting_for) {
+            const uint64_t deadline = qvm->wait_for.start + qvm->wait_for.interval;
+
+            if (deadline <= now) {
+                deadline_blocked = true;
+            } else if (!next || deadline < next) {
+                next = deadline;
+            }
+        }
     }
+
+    arm_deadline(next);
 }
 
-static void cleanup_temps(void **const temps)
+/*
+ * Output of the print built-in functions. By default every call is written
+ * out at once, for interactive programs. With EXEC_BUFFERED_OUTPUT, it goes to
+ * a buffer per thread instead, with the numbers formatted by hand, which is
+ * written out when it fills up, on flush(), before the process blocks or
+ * forks, before write() to the standard output and when the program ends.
+ */
+
+/* the digits of `num` in base `base`, ending at `end`, returns their start */
+static char *format_u64(char *end, uint64_t num, const unsigned base)
 {
-    free(*temps);
+    do {
+        *--end = "0123456789abcdef"[num % base];
+    } while (num /= base);
+
+    return end;
 }
 
-static int handle_return(const struct codegen_insn *insn,
-    const uint64_t retval_size, const void *const retval)
+/* all of mem[0, size), waiting for the descriptor if it is non-blocking */
+static bool write_all(const int fd, const char *mem, size_t size)
 {
-    void *old_temps __attribute__((__cleanup__(cleanup_temps))) = vm->temps;
-    (void) old_temps;
+    while (size) {
+        const ssize_t written = write(fd, mem, size);
+
+        if (written >= 0) {
+            mem += written;
+            size -= (size_t) written;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+            poll(&pfd, 1, -1);
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
 
-    if (vm->sp == 0 && vm->parent) {
-        insn = &o->insns[vm->parent->ip];
+    return true;
+}
 
-        LEGAL_IF(insn->op == (retval_size ? CODEGEN_OP_RTEV : CODEGEN_OP_RTE) ||
-            insn->op == CODEGEN_OP_WAIT, "");
+/*
+ * bwrite(fd, buf, size) goes to a buffer of the descriptor, one per thread,
+ * which is written out along with the output of the print functions and on
+ * close(fd). A write error shows in the bwrite() call that flushes.
+ */
+#ifndef EXEC_FD_BUFFER_SIZE
+#define EXEC_FD_BUFFER_SIZE (64 * 1024)
+#endif
 
-        switch (insn->op) {
-        case CODEGEN_OP_RTEV: {
-            struct qvm *const old_vm = vm;
-            vm = vm->parent;
-            const uint64_t cval_size = opd_size(&insn->un.dst);
-            void *const cval = opd_val(&insn->un.dst);
+struct fd_buffer {
+    int fd;
+    size_t size;
+    char *mem;
+};
 
-            LEGAL_IF(retval_size == cval_size, "%" PRIu64 ", %" PRIu64,
-                retval_size, cval_size);
+static TASK_LOCAL struct {
+    struct fd_buffer *all;
+    size_t count;
+} fd_buffers;
 
-            memcpy(cval, retval, (size_t) cval_size);
-            free(old_vm);
-            *(uint64_t *) opd_val(&insn->un.src) = 0;
-        } break;
+static bool flush_fd_buffer(struct fd_buffer *const buffer)
+{
+    const bool written = write_all(buffer->fd, buffer->mem, buffer->size);
+    buffer->size = 0;
+    return written;
+}
 
-        case CODEGEN_OP_RTE: {
-            struct qvm *const old_vm = vm;
-            vm = vm->parent;
-            free(old_vm);
-            *(uint64_t *) opd_val(&insn->un.src) = 0;
-        } break;
+static void flush_fd_buffers(void)
+{
+    for (size_t idx = 0; idx < fd_buffers.count; ++idx) {
+        flush_fd_buffer(&fd_buffers.all[idx]);
+    }
+}
 
-        case CODEGEN_OP_WAIT: {
-            vm->at_end = 1;
-            vm->last_passed.func = 0;
-            vm->last_passed.id = 0;
+/* flushed and dropped, when its descriptor is closed */
+static void drop_fd_buffer(const int fd)
+{
+    for (size_t idx = 0; idx < fd_buffers.count; ++idx) {
+        if (fd_buffers.all[idx].fd == fd) {
+            flush_fd_buffer(&fd_buffers.all[idx]);
+            free(fd_buffers.all[idx].mem);
+            fd_buffers.all[idx] = fd_buffers.all[--fd_buffers.count];
+            return;
+        }
+    }
+}
 
-            if (retval_size) {
-                memcpy(vm->stack, retval, (size_t) retval_size);
-            }
+static void free_fd_buffers(void)
+{
+    flush_fd_buffers();
 
-            vm->temps = NULL;
-            vm = vm->parent;
-            vm->waiting = 0;
-            vm->waiting_for = 0;
-            vm->waiting_until = 0;
-            vm->waiting_noblock = 0;
-        } break;
-        }
+    for (size_t idx = 0; idx < fd_buffers.count; ++idx) {
+        free(fd_buffers.all[idx].mem);
+    }
 
-        vm->ip++;
-    } else if (vm->sp == 0) {
-        const int status = retval_size ? exit_status_from_retval(insn) : 0;
-        vm->temps = NULL;
-        vm->ip = *(uint64_t *) (vm->stack + vm->sp);
-        vm->bp = *(uint64_t *) (vm->stack + vm->sp + 8);
-        return status;
-    } else {
-        vm->temps = vm->temps->prev;
-        vm->ip = *(uint64_t *) (vm->stack + vm->sp);
-        vm->bp = *(uint64_t *) (vm->stack + vm->sp + 8);
+    free(fd_buffers.all);
+    fd_buffers.all = NULL;
+    fd_buffers.count = 0;
+}
 
-        LEGAL_IF(vm->ip < o->insn_count, "%" PRIu64, vm->ip);
-        LEGAL_IF(vm->bp <= STACK_SIZE, "%" PRIu64, vm->bp);
+static int64_t buffered_write(const int fd, const void *const mem, const size_t size)
+{
+    struct fd_buffer *buffer = NULL;
 
-        if (retval_size) {
-            insn = &o->insns[vm->ip];
-            LEGAL_IF(insn->op == CODEGEN_OP_CALLV, "");
-            const uint64_t cval_size = opd_size(&insn->call.val);
+    for (size_t idx = 0; idx < fd_buffers.count && !buffer; ++idx) {
+        if (fd_buffers.all[idx].fd == fd) {
+            buffer = &fd_buffers.all[idx];
+        }
+    }
 
-            LEGAL_IF(retval_size == cval_size, "%" PRIu64 ", %" PRIu64,
-                retval_size, cval_size);
+    if (!buffer) {
+        struct fd_buffer *const all = realloc(fd_buffers.all,
+            (fd_buffers.count + 1) * sizeof(*all));
 
-            void *const cval = opd_val(&insn->call.val);
-            memcpy(cval, retval, (size_t) cval_size);
+        if (unlikely(!all)) {
+            return -1;
         }
 
-        vm->ip++;
+        fd_buffers.all = all;
+        buffer = &all[fd_buffers.count];
+
+        if (unlikely(!(buffer->mem = malloc(EXEC_FD_BUFFER_SIZE)))) {
+            return -1;
+        }
+
+        buffer->fd = fd;
+        buffer->size = 0;
+        fd_buffers.count++;
     }
 
-    return EXEC_OK;
-}
+    if (buffer->size + size > EXEC_FD_BUFFER_SIZE && !flush_fd_buffer(buffer)) {
+        return -1;
+    }
 
-static int insn_mov(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_MOV);
+    if (size >= EXEC_FD_BUFFER_SIZE) {
+        return write_all(fd, mem, size) ? (int64_t) size : -1;
+    }
 
-    const uint64_t dst_size = opd_size(&insn->un.dst);
-    const uint64_t src_size = opd_size(&insn->un.src);
+    memcpy(buffer->mem + buffer->size, mem, size);
+    buffer->size += size;
+    return (int64_t) size;
+}
 
-    LEGAL_IF(dst_size == src_size, "%" PRIu64 ", %" PRIu64, dst_size, src_size);
+#ifdef EXEC_BUFFERED_OUTPUT
+#ifndef EXEC_OUTPUT_BUFFER_SIZE
+#define EXEC_OUTPUT_BUFFER_SIZE (64 * 1024)
+#endif
 
-    void *const dst = opd_val(&insn->un.dst);
-    const void *const src = opd_val(&insn->un.src);
+static TASK_LOCAL struct {
+    size_t size;
+    char mem[EXEC_OUTPUT_BUFFER_SIZE];
+} output;
 
-    memcpy(dst, src, (size_t) dst_size);
-    return EXEC_OK;
+static void flush_output(void)
+{
+    /* anything printed through stdio, such as the listing, comes first */
+    fflush(stdout);
+    write_all(STDOUT_FILENO, output.mem, output.size);
+    output.size = 0;
+    flush_fd_buffers();
 }
 
-static int insn_cast(const struct codegen_insn *const insn)
+static void put_mem(const char *mem, size_t size)
 {
-    assert(insn->op == CODEGEN_OP_CAST);
+    while (output.size + size > sizeof(output.mem)) {
+        const size_t part = sizeof(output.mem) - output.size;
+        memcpy(output.mem + output.size, mem, part);
+        output.size += part;
+        flush_output();
+        mem += part;
+        size -= part;
+    }
 
-    const uint64_t dst_size = opd_size(&insn->un.dst);
-    const uint64_t src_size = opd_size(&insn->un.src);
+    memcpy(output.mem + output.size, mem, size);
+    output.size += size;
+}
 
-    void *const dst = opd_val(&insn->un.dst);
-    const void *const src = opd_val(&insn->un.src);
+static void put_str(const char *const str)
+{
+    put_mem(str, strlen(str));
+}
 
-    memset(dst, 0, (size_t) dst_size);
-    memcpy(dst, src, src_size < dst_size ? (size_t) src_size : (size_t) dst_size);
-    return EXEC_OK;
+static void put_u64(const uint64_t num)
+{
+    char digits[20];
+    const char *const start = format_u64(digits + sizeof(digits), num, 10);
+    put_mem(start, (size_t) (digits + sizeof(digits) - start));
 }
 
-static int insn_bin_arith(const struct codegen_insn *const insn)
+static void put_i64(const int64_t num)
 {
-    LEGAL_IF(insn->bin.dst.signd == insn->bin.src1.signd &&
-        insn->bin.src1.signd == insn->bin.src2.signd, "differing signedness");
-
-    const uint8_t signd = insn->bin.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->bin.dst);
-    const uint64_t src1_size = opd_size(&insn->bin.src1);
-    const uint64_t src2_size = opd_size(&insn->bin.src2);
-
-    LEGAL_IF(powerof2(dst_size) && dst_size <= 8, "%" PRIu64, dst_size);
-    LEGAL_IF(powerof2(src1_size) && src1_size <= 8, "%" PRIu64, src1_size);
-    LEGAL_IF(powerof2(src2_size) && src2_size <= 8, "%" PRIu64, src2_size);
-    LEGAL_IF(dst_size == src1_size && src1_size == src2_size, "differing sizes");
-
-    void *const dst = opd_val(&insn->bin.dst);
-    const void *const src1 = opd_val(&insn->bin.src1);
-    const void *const src2 = opd_val(&insn->bin.src2);
-
-    #define ARITH_OP(op) \
-    switch (dst_size) { \
-    case 1: \
-        if (signd) { \
-            *(int8_t *) dst = (int8_t) (*(int8_t *) src1 op *(int8_t *) src2); \
-        } else { \
-            *(uint8_t *) dst = (uint8_t) (*(uint8_t *) src1 op *(uint8_t *) src2); \
-        } \
-        break; \
-    \
-    case 2: \
-        if (signd) { \
-            *(int16_t *) dst = (int16_t) (*(int16_t *) src1 op *(int16_t *) src2); \
-        } else { \
-            *(uint16_t *) dst = (uint16_t) (*(uint16_t *) src1 op *(uint16_t *) src2); \
-        } \
-        break; \
-    \
-    case 4: \
-        if (signd) { \
-            *(int32_t *) dst = *(int32_t *) src1 op *(int32_t *) src2; \
-        } else { \
-            *(uint32_t *) dst = *(uint32_t *) src1 op *(uint32_t *) src2; \
-        } \
-        break; \
-    \
-    case 8: \
-        if (signd) { \
-            *(int64_t *) dst = *(int64_t *) src1 op *(int64_t *) src2; \
-        } else { \
-            *(uint64_t *) dst = *(uint64_t *) src1 op *(uint64_t *) src2; \
-        } \
-        break; \
-    }
-
-    switch (insn->op) {
-    case CODEGEN_OP_ADD: ARITH_OP( +); break;
-    case CODEGEN_OP_SUB: ARITH_OP( -); break;
-    case CODEGEN_OP_MUL: ARITH_OP( *); break;
-    case CODEGEN_OP_DIV: ARITH_OP( /); break;
-    case CODEGEN_OP_MOD: ARITH_OP( %); break;
-    case CODEGEN_OP_LSH: ARITH_OP(<<); break;
-    case CODEGEN_OP_RSH: ARITH_OP(>>); break;
-    case CODEGEN_OP_AND: ARITH_OP( &); break;
-    case CODEGEN_OP_XOR: ARITH_OP( ^); break;
-    case CODEGEN_OP_OR:  ARITH_OP( |); break;
-    default: assert(0), abort();
+    if (num < 0) {
+        put_mem("-", 1);
+        put_u64(-(uint64_t) num);
+    } else {
+        put_u64((uint64_t) num);
     }
-
-    #undef ARITH_OP
-    return EXEC_OK;
 }
-
-static int insn_equ_neq(const struct codegen_insn *const insn)
+#else
+static void flush_output(void)
 {
-    assert(insn->op == CODEGEN_OP_EQU || insn->op == CODEGEN_OP_NEQ);
-
-    const uint8_t dst_signd = insn->bin.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->bin.dst);
-    const uint64_t src1_size = opd_size(&insn->bin.src1);
-    const uint64_t src2_size = opd_size(&insn->bin.src2);
-
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_size == 1, "%" PRIu64, dst_size);
-    LEGAL_IF(src1_size == src2_size, "%" PRIu64 ", %" PRIu64, src1_size, src2_size);
-
-    uint8_t *const dst = opd_val(&insn->bin.dst);
-    const void *const src1 = opd_val(&insn->bin.src1);
-    const void *const src2 = opd_val(&insn->bin.src2);
+    fflush(stdout);
+    flush_fd_buffers();
+}
 
-    const int equal = !memcmp(src1, src2, (size_t) src1_size);
-    *dst = insn->op == CODEGEN_OP_EQU ? (equal ? 1 : 0) : !equal;
-    return EXEC_OK;
+static void put_mem(const char *const mem, const size_t size)
+{
+    fwrite(mem, 1, size, stdout);
+    fflush(stdout);
 }
 
-static int insn_bin_logic(const struct codegen_insn *const insn)
+static void put_str(const char *const str)
 {
-    assert(insn->op == CODEGEN_OP_LT || insn->op == CODEGEN_OP_GT ||
-        insn->op == CODEGEN_OP_LTE || insn->op == CODEGEN_OP_GTE);
+    printf("%s", str);
+    fflush(stdout);
+}
 
-    const uint8_t dst_signd = insn->bin.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->bin.dst);
+static void put_u64(const uint64_t num)
+{
+    printf("%" PRIu64, num);
+    fflush(stdout);
+}
 
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_size == 1, "%" PRIu64, dst_size);
+static void put_i64(const int64_t num)
+{
+    printf("%" PRIi64, num);
+    fflush(stdout);
+}
+#endif
 
-    const uint8_t src1_signd = insn->bin.src1.signd;
-    const uint64_t src1_size = opd_size(&insn->bin.src1);
-    const uint8_t src2_signd = insn->bin.src2.signd;
-    const uint64_t src2_size = opd_size(&insn->bin.src2);
+/*
+ * pf(fmt, args): the record is formatted here and put out in one go. Its
+ * arguments are laid out at `args` as the members of a struct of their types
+ * would be, each aligned to its size.
+ */
+#define RECORD_SIZE 1024
 
-    LEGAL_IF(src1_signd == src2_signd, "differing signedness");
-    LEGAL_IF(powerof2(src1_size) && src1_size <= 8, "%" PRIu64, src1_size);
-    LEGAL_IF(powerof2(src2_size) && src2_size <= 8, "%" PRIu64, src2_size);
-    LEGAL_IF(src1_size == src2_size, "differing sizes");
+struct record {
+    size_t size;
+    char mem[RECORD_SIZE];
+};
 
-    uint8_t *const dst = opd_val(&insn->bin.dst);
-    const void *const src1 = opd_val(&insn->bin.src1);
-    const void *const src2 = opd_val(&insn->bin.src2);
+static void record_put(struct record *const record, const char *const mem, const size_t size)
+{
+    if (record->size + size > sizeof(record->mem)) {
+        put_mem(record->mem, record->size);
+        record->size = 0;
 
-    #define LOGIC_OP(op) \
-    switch (src1_size) { \
-    case 1: \
-        if (src1_signd) { \
-            *dst = *(int8_t *) src1 op *(int8_t *) src2; \
-        } else { \
-            *dst = *(uint8_t *) src1 op *(uint8_t *) src2; \
-        } \
-        break; \
-    \
-    case 2: \
-        if (src1_signd) { \
-            *dst = *(int16_t *) src1 op *(int16_t *) src2; \
-        } else { \
-            *dst = *(uint16_t *) src1 op *(uint16_t *) src2; \
-        } \
-        break; \
-    \
-    case 4: \
-        if (src1_signd) { \
-            *dst = *(int32_t *) src1 op *(int32_t *) src2; \
-        } else { \
-            *dst = *(uint32_t *) src1 op *(uint32_t *) src2; \
-        } \
-        break; \
-    \
-    case 8: \
-        if (src1_signd) { \
-            *dst = *(int64_t *) src1 op *(int64_t *) src2; \
-        } else { \
-            *dst = *(uint64_t *) src1 op *(uint64_t *) src2; \
-        } \
-        break; \
+        if (size > sizeof(record->mem)) {
+            put_mem(mem, size);
+            return;
+        }
     }
 
-    switch (insn->op) {
-    case CODEGEN_OP_LT:  LOGIC_OP( <); break;
-    case CODEGEN_OP_GT:  LOGIC_OP( >); break;
-    case CODEGEN_OP_LTE: LOGIC_OP(<=); break;
-    case CODEGEN_OP_GTE: LOGIC_OP(>=); break;
-    default: assert(0), abort();
-    }
+    memcpy(record->mem + record->size, mem, size);
+    record->size += size;
+}
 
-    #undef LOGIC_OP
-    return EXEC_OK;
+/* the argument at the next offset aligned to `size`, zero-extended */
+static uint64_t format_arg(const uint8_t *const args, uint64_t *const off, const unsigned size)
+{
+    uint8_t bytes[8] = {0};
+    ALIGN_UP(*off, size);
+    memcpy(bytes, args + *off, size);
+    *off += size;
+
+    switch (size) {
+    case 1: return *(uint8_t *) bytes;
+    case 2: return *(uint16_t *) bytes;
+    case 4: return *(uint32_t *) bytes;
+    default: return *(uint64_t *) bytes;
+    }
 }
 
-static int insn_not(const struct codegen_insn *const insn)
+static void print_format(const char *fmt, const uint8_t *const args)
 {
-    assert(insn->op == CODEGEN_OP_NOT);
+    struct record record = { .size = 0 };
+    uint64_t off = 0;
 
-    const uint8_t dst_signd = insn->un.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->un.dst);
+    while (*fmt) {
+        const char *const text = fmt;
 
-    LEGAL_IF(dst_signd == 0 || dst_signd == 1, "%u", dst_signd);
-    LEGAL_IF(powerof2(dst_size) && dst_size <= 8, "%" PRIu64, dst_size);
+        while (*fmt && *fmt != '%') {
+            fmt++;
+        }
 
-    const uint8_t src_signd = insn->un.src.signd;
-    const uint64_t src_size = opd_size(&insn->un.src);
+        record_put(&record, text, (size_t) (fmt - text));
 
-    LEGAL_IF(src_signd == dst_signd, "%u, %u", src_signd, dst_signd);
-    LEGAL_IF(powerof2(src_size) && src_size <= 8, "%" PRIu64, src_size);
-    LEGAL_IF(dst_size == src_size, "%" PRIu64 ", %" PRIu64, dst_size, src_size);
+        if (!*fmt) {
+            break;
+        }
 
-    void *const dst = opd_val(&insn->un.dst);
-    const void *const src = opd_val(&insn->un.src);
+        const char conv = *++fmt;
+        unsigned bits = 0;
 
-    switch (dst_size) {
-    case 1:
-        if (dst_signd) {
-            *(int8_t *) dst = !*(int8_t *) src;
-        } else {
-            *(uint8_t *) dst = !*(uint8_t *) src;
-        }
-        break;
+        if (conv == 'u' || conv == 'i' || conv == 'x') {
+            for (const char *digit = fmt + 1; *digit >= '0' && *digit <= '9'; ++digit) {
+                bits = 10 * bits + (unsigned) (*digit - '0');
 
-    case 2:
-        if (dst_signd) {
-            *(int16_t *) dst = !*(int16_t *) src;
-        } else {
-            *(uint16_t *) dst = !*(uint16_t *) src;
+                if (bits > 64) {
+                    break;
+                }
+            }
         }
-        break;
 
-    case 4:
-        if (dst_signd) {
-            *(int32_t *) dst = !*(int32_t *) src;
-        } else {
-            *(uint32_t *) dst = !*(uint32_t *) src;
-        }
-        break;
+        if (conv == '%') {
+            record_put(&record, "%", 1);
+            fmt++;
+        } else if (conv == 'n') {
+            record_put(&record, "\n", 1);
+            fmt++;
+        } else if (conv == 'c') {
+            const char c = (char) format_arg(args, &off, 1);
+            record_put(&record, &c, 1);
+            fmt++;
+        } else if (conv == 's') {
+            const char *const str = (const char *) (uintptr_t) format_arg(args, &off, 8);
+            record_put(&record, str ? str : "(null)", strlen(str ? str : "(null)"));
+            fmt++;
+        } else if (bits == 8 || bits == 16 || bits == 32 || bits == 64) {
+            uint64_t num = format_arg(args, &off, bits / 8);
+            const bool negative = conv == 'i' && bits < 64 ?
+                num >> (bits - 1) & 1 : conv == 'i' && (int64_t) num < 0;
+
+            char digits[21];
+            char *start;
+
+            if (negative) {
+                num = bits < 64 ? (UINT64_C(1) << bits) - num : -num;
+            }
 
-    case 8:
-        if (dst_signd) {
-            *(int64_t *) dst = !*(int64_t *) src;
+            start = format_u64(digits + sizeof(digits), num, conv == 'x' ? 16 : 10);
+
+            if (negative) {
+                *--start = '-';
+            }
+
+            record_put(&record, start, (size_t) (digits + sizeof(digits) - start));
+            fmt += 1 + (bits < 10 ? 1 : 2);
         } else {
-            *(uint64_t *) dst = !*(uint64_t *) src;
+            /* not a conversion, left as it is */
+            record_put(&record, "%", 1);
         }
-        break;
     }
 
-    return EXEC_OK;
+    if (record.size) {
+        put_mem(record.mem, record.size);
+    }
 }
 
-static int insn_neg(const struct codegen_insn *const insn)
+/*
+ * The I/O reactor: a quaint whose I/O built-in function would block is parked
+ * on the file descriptor instead, in a list per descriptor, along with the
+ * quaints that wait for it. Meanwhile, another quaint of a wait-any runs or a
+ * noblock wait returns. Only when nothing else can run does the process block
+ * in epoll (poll elsewhere), until a descriptor or the next deadline is due.
+ * A ready descriptor unparks all of its VMs, which then retry their I/O.
+ */
+static TASK_LOCAL struct {
+    struct qvm **parked; /* per descriptor, linked through park_next */
+    int size;
+#ifdef __linux__
+    int epfd;
+#endif
+} reactor = {
+#ifdef __linux__
+    .epfd = -1,
+#endif
+};
+
+static void unpark(struct qvm *const qvm)
 {
-    assert(insn->op == CODEGEN_OP_NEG);
+    struct qvm **link = &reactor.parked[qvm->park_fd];
 
-    const uint8_t dst_signd = insn->un.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->un.dst);
+    while (*link != qvm) {
+        link = &(*link)->park_next;
+    }
 
-    LEGAL_IF(dst_signd == 1, "%u", dst_signd);
-    LEGAL_IF(powerof2(dst_size) && dst_size <= 8, "%" PRIu64, dst_size);
+    *link = qvm->park_next;
+    qvm->parked = 0;
 
-    const uint8_t src_signd = insn->un.src.signd;
-    const uint64_t src_size = opd_size(&insn->un.src);
+#ifdef __linux__
+    if (!reactor.parked[qvm->park_fd]) {
+        epoll_ctl(reactor.epfd, EPOLL_CTL_DEL, qvm->park_fd, NULL);
+    }
+#endif
+}
 
-    LEGAL_IF(src_signd == 0 || src_signd == 1, "%u", src_signd);
-    LEGAL_IF(powerof2(src_size) && src_size <= 8, "%" PRIu64, src_size);
-    LEGAL_IF(dst_size == src_size, "%" PRIu64 ", %" PRIu64, dst_size, src_size);
+/* `events` is POLLIN or POLLOUT */
+static int park(struct qvm *const qvm, const int fd, const int16_t events)
+{
+    if (qvm->parked) {
+        if (qvm->park_fd == fd && qvm->park_events == events) {
+            return EXEC_OK;
+        }
 
-    void *const dst = opd_val(&insn->un.dst);
-    const void *const src = opd_val(&insn->un.src);
+        unpark(qvm);
+    }
 
-    switch (dst_size) {
-    case 1:
-        if (src_signd) {
-            *(int8_t *) dst = (int8_t) -*(int8_t *) src;
-        } else {
-            *(int8_t *) dst = (int8_t) -*(uint8_t *) src;
-        }
-        break;
+    if (fd >= reactor.size) {
+        const int size = fd < 32 ? 64 : 2 * fd;
+        struct qvm **const parked = realloc(reactor.parked, (size_t) size * sizeof(*parked));
 
-    case 2:
-        if (src_signd) {
-            *(int16_t *) dst = (int16_t) -*(int16_t *) src;
-        } else {
-            *(int16_t *) dst = (int16_t) -*(uint16_t *) src;
+        if (unlikely(!parked)) {
+            return EXEC_NOMEM;
         }
-        break;
 
-    case 4:
-        if (src_signd) {
-            *(int32_t *) dst = -*(int32_t *) src;
-        } else {
-            *(int32_t *) dst = (int32_t) -*(uint32_t *) src;
-        }
-        break;
+        memset(parked + reactor.size, 0, (size_t) (size - reactor.size) * sizeof(*parked));
+        reactor.parked = parked;
+        reactor.size = size;
+    }
 
-    case 8:
-        if (src_signd) {
-            *(int64_t *) dst = -*(int64_t *) src;
-        } else {
-            *(int64_t *) dst = (int64_t) -*(uint64_t *) src;
-        }
-        break;
+#ifdef __linux__
+    if (reactor.epfd < 0 && unlikely((reactor.epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)) {
+        return perror("epoll_create1"), EXEC_NOMEM;
+    }
+
+    int16_t all_events = events;
+
+    for (const struct qvm *other = reactor.parked[fd]; other; other = other->park_next) {
+        all_events |= other->park_events;
+    }
+
+    struct epoll_event event = {
+        .events = (all_events & POLLIN ? EPOLLIN : 0) | (all_events & POLLOUT ? EPOLLOUT : 0),
+        .data.fd = fd,
+    };
+
+    /* the descriptor may have been closed and reopened since it was added */
+    if (epoll_ctl(reactor.epfd, reactor.parked[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) &&
+        (errno != ENOENT || epoll_ctl(reactor.epfd, EPOLL_CTL_ADD, fd, &event))) {
+
+        return perror("epoll_ctl"), EXEC_NOMEM;
     }
+#endif
 
+    qvm->parked = 1;
+    qvm->park_fd = fd;
+    qvm->park_events = events;
+    qvm->park_next = reactor.parked[fd];
+    reactor.parked[fd] = qvm;
     return EXEC_OK;
 }
 
-static int insn_bneg(const struct codegen_insn *const insn)
+static void wake(const int fd)
 {
-    assert(insn->op == CODEGEN_OP_BNEG);
+    while (reactor.parked[fd]) {
+        unpark(reactor.parked[fd]);
+    }
+}
 
-    const uint8_t dst_signd = insn->un.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->un.dst);
+/* blocks until a parked VM may go on or the armed deadline is due */
+static int reactor_wait(void)
+{
+    int timeout = -1;
 
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(powerof2(dst_size) && dst_size <= 8, "%" PRIu64, dst_size);
+    if (armed_deadline) {
+        if (unlikely(get_monotonic_time(&now))) {
+            return EXEC_NOMEM;
+        }
 
-    const uint8_t src_signd = insn->un.src.signd;
-    const uint64_t src_size = opd_size(&insn->un.src);
+        if (armed_deadline <= now) {
+            return deadline_passed = 1, EXEC_OK;
+        }
 
-    LEGAL_IF(src_signd == 0, "%u", src_signd);
-    LEGAL_IF(powerof2(src_size) && src_size <= 8, "%" PRIu64, src_size);
-    LEGAL_IF(dst_size == src_size, "%" PRIu64 ", %" PRIu64, dst_size, src_size);
+        const uint64_t left = (armed_deadline - now + 999999) / 1000000;
+        timeout = left < INT32_MAX ? (int) left : INT32_MAX;
+    }
 
-    void *const dst = opd_val(&insn->un.dst);
-    const void *const src = opd_val(&insn->un.src);
+    flush_output();
 
-    switch (dst_size) {
-    case 1:
-        *(uint8_t *) dst = ~*(uint8_t *) src;
-        break;
+#ifdef __linux__
+    struct epoll_event events[64];
+    const int count = epoll_wait(reactor.epfd, events, countof(events), timeout);
 
-    case 2:
-        *(uint16_t *) dst = ~*(uint16_t *) src;
-        break;
+    for (int idx = 0; idx < count; ++idx) {
+        wake(events[idx].data.fd);
+    }
+#else
+    struct pollfd *const fds = malloc((size_t) reactor.size * sizeof(*fds));
+    nfds_t nfds = 0;
 
-    case 4:
-        *(uint32_t *) dst = ~*(uint32_t *) src;
-        break;
+    if (unlikely(!fds)) {
+        return EXEC_NOMEM;
+    }
 
-    case 8:
-        *(uint64_t *) dst = ~*(uint64_t *) src;
-        break;
+    for (int fd = 0; fd < reactor.size; ++fd) {
+        int16_t all_events = 0;
+
+        for (const struct qvm *qvm = reactor.parked[fd]; qvm; qvm = qvm->park_next) {
+            all_events |= qvm->park_events;
+        }
+
+        if (all_events) {
+            fds[nfds++] = (struct pollfd) { .fd = fd, .events = all_events };
+        }
+    }
+
+    const int count = poll(fds, nfds, timeout);
+
+    for (nfds_t idx = 0; count > 0 && idx < nfds; ++idx) {
+        if (fds[idx].revents) {
+            wake(fds[idx].fd);
+        }
+    }
+
+    free(fds);
+#endif
+
+    if (count < 0 && errno != EINTR) {
+        return perror("reactor"), EXEC_NOMEM;
+    }
+
+    if (count == 0) {
+        deadline_passed = 1;
     }
 
     return EXEC_OK;
 }
 
-static int insn_oz(const struct codegen_insn *const insn)
+static void free_reactor(void)
 {
-    assert(insn->op == CODEGEN_OP_OZ);
+    free(reactor.parked);
+    reactor.parked = NULL;
+    reactor.size = 0;
+#ifdef __linux__
+    if (reactor.epfd >= 0) {
+        close(reactor.epfd);
+        reactor.epfd = -1;
+    }
+#endif
+}
 
-    const uint8_t dst_signd = insn->un.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->un.dst);
+/* safepoints that a quaint of a wait-any runs before the next one's turn */
+#ifndef EXEC_SLICE
+#define EXEC_SLICE 256
+#endif
 
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_size == 1, "%" PRIu64, dst_size);
+/* for a wait-any, `index` is the quaint that completed, or any_count if none */
+static void end_wait(struct qvm *const qvm, const uint32_t index)
+{
+    if (qvm->waiting_any) {
+        qvm->sp -= 8 * (uint64_t) qvm->any_count;
+        qvm->waited = index;
+    }
 
-    const uint8_t src_signd = insn->un.src.signd;
-    const uint64_t src_size = opd_size(&insn->un.src);
+    qvm->waiting = 0;
+    qvm->waiting_for = 0;
+    qvm->waiting_until = 0;
+    qvm->waiting_noblock = 0;
+    qvm->waiting_any = 0;
 
-    LEGAL_IF(src_signd == 0 || src_signd == 1, "%u", src_signd);
-    LEGAL_IF(powerof2(src_size) && src_size <= 8, "%" PRIu64, src_size);
+    if (qvm->parked) {
+        unpark(qvm);
+    }
+}
 
-    uint8_t *const dst = opd_val(&insn->un.dst);
-    const void *const src = opd_val(&insn->un.src);
+/*
+ * The next quaint of a wait-any in turn that is neither null nor parked, already
+ * marked as running, the running one itself being the last one if `with_current`.
+ */
+static struct qvm *next_in_turn(struct qvm *const qvm, const bool with_current)
+{
+    const uint64_t *const list =
+        (const uint64_t *) (qvm->stack + qvm->sp) - qvm->any_count;
+
+    for (uint32_t step = 1; step < qvm->any_count + with_current; ++step) {
+        const uint32_t idx = (qvm->any_current + step) % qvm->any_count;
+        struct qvm *const next = (struct qvm *) (uintptr_t) list[idx];
+
+        if (next && !next->parked) {
+            qvm->any_current = idx;
+            qvm->any_slice = EXEC_SLICE;
+            next->parent = qvm;
+            next->may_split = 1;
+            return next;
+        }
+    }
 
-    switch (src_size) {
-    case 1:
-        *dst = src_signd ? (*(int8_t *) src ? 1 : 0) : (*(uint8_t *) src ? 1 : 0);
-        break;
+    return NULL;
+}
 
-    case 2:
-        *dst = src_signd ? (*(int16_t *) src ? 1 : 0) : (*(uint16_t *) src ? 1 : 0);
-        break;
+/*
+ * The VM has just been parked: the nearest wait-any up the chain goes on with
+ * another quaint, or else the nearest noblock wait returns, and the VMs in
+ * between are parked along. With neither, the process blocks in the reactor
+ * and tries again, unless a deadline is due for the safepoint to handle.
+ */
+static int block(void)
+{
+    struct qvm *const parked = vm;
 
-    case 4:
-        *dst = src_signd ? (*(int32_t *) src ? 1 : 0) : (*(uint32_t *) src ? 1 : 0);
-        break;
+    while (parked->parked) {
+        uint8_t noint = parked->noint;
+        struct qvm *old_vm = parked, *current_vm = parked->parent;
 
-    case 8:
-        *dst = src_signd ? (*(int64_t *) src ? 1 : 0) : (*(uint64_t *) src ? 1 : 0);
-        break;
+        while (current_vm && !noint) {
+            int error;
+
+            if (old_vm != parked &&
+                unlikely((error = park(old_vm, parked->park_fd, parked->park_events)))) {
+
+                return error;
+            }
+
+            struct qvm *const next_vm = current_vm->waiting_any ?
+                next_in_turn(current_vm, false) : NULL;
+
+            if (next_vm) {
+                return vm = next_vm, EXEC_OK;
+            }
+
+            if (current_vm->waiting_noblock) {
+                end_wait(current_vm, current_vm->any_count);
+                current_vm->ip++;
+                return vm = current_vm, EXEC_OK;
+            }
+
+            noint = current_vm->noint;
+            old_vm = current_vm;
+            current_vm = current_vm->parent;
+        }
+
+#ifdef EXEC_TASKS
+        if (deadline_passed && (!task_self || armed_deadline <= now)) {
+#else
+        if (deadline_passed) {
+#endif
+            return EXEC_OK;
+        }
+
+        const int error = reactor_wait();
+
+        if (unlikely(error)) {
+            return error;
+        }
     }
 
     return EXEC_OK;
 }
 
-static int insn_inc_dec(const struct codegen_insn *const insn)
+/* parks the VM on the descriptor, to go on when it is ready */
+static int park_on(const int fd, const int16_t events)
 {
-    assert(insn->op == CODEGEN_OP_INC || insn->op == CODEGEN_OP_DEC);
+    const int error = park(vm, fd, events);
+    return unlikely(error) ? error : block();
+}
 
-    const uint8_t dst_signd = insn->dst.signd;
-    const uint64_t dst_size = opd_size(&insn->dst);
+/* whether the descriptor is ready for the VM, which is parked on it if not */
+static int io_ready(const int fd, const int16_t events, bool *const ready)
+{
+    struct pollfd pfd = { .fd = fd, .events = events };
+
+    /*
+     * An error is reported by the I/O function itself, which includes a bad
+     * descriptor: poll() reports POLLNVAL for one, but ignores a negative one.
+     */
+    if ((*ready = fd < 0 || poll(&pfd, 1, 0) != 0)) {
+        if (vm->parked) {
+            unpark(vm);
+        }
 
-    LEGAL_IF(dst_signd == 0 || dst_signd == 1, "%u", dst_signd);
-    LEGAL_IF(powerof2(dst_size) && dst_size <= 8, "%" PRIu64, dst_size);
+        return EXEC_OK;
+    }
 
-    void *const dst = opd_val(&insn->dst);
+    return park_on(fd, events);
+}
 
-    #define INC_DEC_OP(op) \
-    switch (dst_size) { \
-    case 1: \
-        if (dst_signd) { \
-            (*(int8_t *) dst)op; \
-        } else { \
-            (*(uint8_t *) dst)op; \
-        } \
-        break; \
-    \
-    case 2: \
-        if (dst_signd) { \
-            (*(int16_t *) dst)op; \
-        } else { \
-            (*(uint16_t *) dst)op; \
-        } \
-        break; \
-    \
-    case 4: \
-        if (dst_signd) { \
-            (*(int32_t *) dst)op; \
-        } else { \
-            (*(uint32_t *) dst)op; \
-        } \
-        break; \
-    \
-    case 8: \
-        if (dst_signd) { \
-            (*(int64_t *) dst)op; \
-        } else { \
-            (*(uint64_t *) dst)op; \
-        } \
-        break; \
+/* the VM to switch to, already marked as running, or NULL to stay */
+static struct qvm *check_and_eventually_split_vms(void)
+{
+    const bool timed_out = deadline_passed;
+
+    if (timed_out) {
+        deadline_passed = 0;
+
+        if (get_monotonic_time(&now)) {
+            return NULL;
+        }
     }
 
-    if (insn->op == CODEGEN_OP_INC) {
-        INC_DEC_OP(++);
-    } else {
-        INC_DEC_OP(--);
+    uint8_t noint = vm->noint;
+    struct qvm *old_vm = vm, *current_vm = vm->parent, *turn = NULL;
+
+    while (current_vm && !noint) {
+        bool split = false;
+
+        if (current_vm->waiting) {
+            if (current_vm->waiting_for) {
+                split = timed_out &&
+                    now - current_vm->wait_for.start >= current_vm->wait_for.interval;
+            } else if (current_vm->waiting_until) {
+                split = old_vm->last_passed == current_vm->wait_until;
+            }
+        }
+
+        if (split) {
+            end_wait(current_vm, current_vm->waiting_for ?
+                current_vm->any_count : current_vm->any_current);
+
+            current_vm->ip++;
+
+            if (timed_out) {
+                arm_next_deadline(current_vm);
+            }
+
+            return current_vm;
+        }
+
+        /* the outermost wait-any whose turn is over switches first */
+        if (current_vm->waiting_any && !--current_vm->any_slice) {
+            turn = current_vm;
+        }
+
+        noint = current_vm->noint;
+        old_vm = current_vm;
+        current_vm = current_vm->parent;
     }
 
-    #undef INC_DEC_OP
-    return EXEC_OK;
+    struct qvm *const next_vm = turn ? next_in_turn(turn, true) : NULL;
+
+    if (timed_out) {
+        arm_next_deadline(next_vm ? next_vm : vm);
+    }
+
+    return next_vm;
 }
 
-static int insn_incp_decp(const struct codegen_insn *const insn)
+/*
+ * Arenas hand out memory by bumping an offset into the newest of their chunks
+ * and give it all back at once on reset or free.
+ */
+struct arena_chunk {
+    struct arena_chunk *next;
+    uint64_t size;
+    uint8_t mem[] __attribute__((aligned(16)));
+};
+
+#define EXEC_ARENA_CHUNK_SIZE (1024 * 1024 - sizeof(struct arena_chunk))
+
+struct arena {
+    struct arena_chunk *chunks;
+    uint64_t top;
+};
+
+static void *arena_alloc(struct arena *const arena, const uint64_t size)
 {
-    assert(insn->op == CODEGEN_OP_INCP || insn->op == CODEGEN_OP_DECP);
+    const uint64_t aligned = (size + 15) & ~(uint64_t) 15;
+    struct arena_chunk *chunk = arena->chunks;
 
-    const uint8_t dst_signd = insn->un.dst.signd;
-    const uint64_t dst_size = opd_size(&insn->un.dst);
+    if (unlikely(aligned < size)) {
+        return NULL;
+    }
 
-    LEGAL_IF(dst_signd == 0 || dst_signd == 1, "%u", dst_signd);
-    LEGAL_IF(powerof2(dst_size) && dst_size <= 8, "%" PRIu64, dst_size);
+    if (unlikely(!chunk || arena->top + aligned > chunk->size)) {
+        const uint64_t chunk_size = aligned > EXEC_ARENA_CHUNK_SIZE ?
+            aligned : EXEC_ARENA_CHUNK_SIZE;
 
-    const uint8_t src_signd = insn->un.src.signd;
-    const uint64_t src_size = opd_size(&insn->un.src);
+        if (unlikely(chunk_size > UINT64_MAX - sizeof(struct arena_chunk) ||
+            !(chunk = heap_alloc(sizeof(struct arena_chunk) + chunk_size, false)))) {
+            return NULL;
+        }
 
-    LEGAL_IF(src_signd == dst_signd, "%u, %u", src_signd, dst_signd);
-    LEGAL_IF(powerof2(src_size) && src_size <= 8, "%" PRIu64, src_size);
-    LEGAL_IF(dst_size == src_size, "%" PRIu64 ", %" PRIu64, dst_size, src_size);
+        chunk->next = arena->chunks;
+        chunk->size = chunk_size;
+        arena->chunks = chunk;
+        arena->top = 0;
+    }
 
-    void *const dst = opd_val(&insn->un.dst);
-    void *const src = opd_val(&insn->un.src);
+    void *const mem = chunk->mem + arena->top;
+    arena->top += aligned;
+    return mem;
+}
 
-    #define INCP_DECP_OP(op) \
-    switch (dst_size) { \
-    case 1: \
-        if (dst_signd) { \
-            *(int8_t *) dst = (*(int8_t *) src)op; \
-        } else { \
-            *(uint8_t *) dst = (*(uint8_t *) src)op; \
-        } \
-        break; \
-    \
-    case 2: \
-        if (dst_signd) { \
-            *(int16_t *) dst = (*(int16_t *) src)op; \
-        } else { \
-            *(uint16_t *) dst = (*(uint16_t *) src)op; \
-        } \
-        break; \
-    \
-    case 4: \
-        if (dst_signd) { \
-            *(int32_t *) dst = (*(int32_t *) src)op; \
-        } else { \
-            *(uint32_t *) dst = (*(uint32_t *) src)op; \
-        } \
-        break; \
-    \
-    case 8: \
-        if (dst_signd) { \
-            *(int64_t *) dst = (*(int64_t *) src)op; \
-        } else { \
-            *(uint64_t *) dst = (*(uint64_t *) src)op; \
-        } \
-        break; \
+static void arena_reset(struct arena *const arena)
+{
+    struct arena_chunk *const chunk = arena->chunks;
+
+    if (!chunk) {
+        return;
     }
 
-    if (insn->op == CODEGEN_OP_INCP) {
-        INCP_DECP_OP(++);
-    } else {
-        INCP_DECP_OP(--);
+    for (struct arena_chunk *next, *it = chunk->next; it; it = next) {
+        next = it->next;
+        heap_free(it);
+    }
+
+    chunk->next = NULL;
+    arena->top = 0;
+}
+
+static void arena_free(struct arena *const arena)
+{
+    for (struct arena_chunk *next, *it = arena->chunks; it; it = next) {
+        next = it->next;
+        heap_free(it);
+    }
+
+    heap_free(arena);
+}
+
+#ifdef CODEGEN_HEAP_TEMPS
+static int push_temps(const uint64_t tsize)
+{
+    const uint64_t size = sizeof(struct tmp_frame) + ((tsize + 7) & ~(uint64_t) 7);
+    struct tmp_chunk *chunk = vm->tmp_chunk;
+
+    if (unlikely(!chunk || chunk->top + size > chunk->size)) {
+        struct tmp_chunk **const link = chunk ? &chunk->next : &vm->tmp_chunks;
+
+        if (*link && (*link)->size < size) {
+            for (struct tmp_chunk *next; *link; *link = next) {
+                next = (*link)->next;
+                free(*link);
+            }
+        }
+
+        if (!*link) {
+            const uint64_t chunk_size = size > TMP_CHUNK_SIZE ? size : TMP_CHUNK_SIZE;
+
+            if (unlikely(!(*link = malloc(sizeof(struct tmp_chunk) + (size_t) chunk_size)))) {
+                return EXEC_NOMEM;
+            }
+
+            note_heap(*link, sizeof(struct tmp_chunk) + chunk_size);
+
+            (*link)->next = NULL;
+            (*link)->size = chunk_size;
+        }
+
+        chunk = *link;
+        chunk->top = 0;
+    }
+
+    struct tmp_frame *const frame = (struct tmp_frame *) (chunk->mem + chunk->top);
+    frame->prev = vm->temps;
+    frame->chunk = vm->tmp_chunk;
+    frame->top = vm->tmp_chunk ? vm->tmp_chunk->top : 0;
+    chunk->top += size;
+    vm->tmp_chunk = chunk;
+    vm->temps = frame;
+    return EXEC_OK;
+}
+
+static void pop_temps(void)
+{
+    struct tmp_frame *const frame = vm->temps;
+
+    if ((vm->tmp_chunk = frame->chunk)) {
+        vm->tmp_chunk->top = frame->top;
+    }
+
+    vm->temps = frame->prev;
+}
+
+static void free_temps(struct qvm *const qvm)
+{
+    for (struct tmp_chunk *chunk = qvm->tmp_chunks, *next; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
     }
 
-    #undef INCP_DECP_OP
-    return EXEC_OK;
-}
+    qvm->temps = NULL;
+    qvm->tmp_chunks = qvm->tmp_chunk = NULL;
+}
+#endif
+
+/*
+ * Released VMs are kept on a free list, up to a high-water mark, so that
+ * quaints are recycled without going through the allocator. Their stacks are
+ * not zeroed again, as the frames are initialised explicitly anyway.
+ *
+ * A quaint whose stack needs are known gets a VM just large enough for them,
+ * so there is a free list per size class: VMs of class c take 256 << c bytes,
+ * the last class being the full STACK_SIZE. With EXEC_MMAP_STACKS, where
+ * untouched stack costs nothing, there is only that class.
+ */
+#ifndef EXEC_QVM_POOL_MAX
+#define EXEC_QVM_POOL_MAX 256
+#endif
+
+#ifdef EXEC_MMAP_STACKS
+#define POOL_CLASS_COUNT 1
+#else
+#define POOL_CLASS_COUNT 7
+static_assert(sizeof(struct qvm) + STACK_SIZE == 256 << (POOL_CLASS_COUNT - 1), "");
+#endif
+
+static TASK_LOCAL struct {
+    struct qvm *free[POOL_CLASS_COUNT]; /* linked through the parent pointers */
+    uint64_t count;
+#ifdef EXEC_QVM_STATS
+    uint64_t allocs, reuses, releases, frees, live, peak_live;
+#endif
+} pool;
+
+#ifdef EXEC_MMAP_STACKS
+static struct qvm *new_vm(const size_t class)
+{
+    (void) class;
+
+    /*
+     * The VMs start at varying offsets into their first page, or else all of
+     * them would compete for the same cache sets.
+     */
+    static TASK_LOCAL unsigned colour;
+
+    const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t offset = 64 * (colour++ % 32) % page_size;
+    uint8_t *const mem = mmap(NULL, EXEC_STACK_RESERVE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (unlikely(mem == MAP_FAILED)) {
+        return NULL;
+    }
+
+    if (unlikely(mprotect(mem + EXEC_STACK_RESERVE - page_size, page_size, PROT_NONE))) {
+        munmap(mem, EXEC_STACK_RESERVE);
+        return NULL;
+    }
+
+    struct qvm *const qvm = (struct qvm *) (mem + offset);
+    qvm->stack_size = EXEC_STACK_RESERVE - page_size - offset - sizeof(struct qvm);
+    note_heap(mem, EXEC_STACK_RESERVE);
+    return qvm;
+}
+
+static void delete_vm(struct qvm *const qvm)
+{
+    const uintptr_t page_mask = (uintptr_t) sysconf(_SC_PAGESIZE) - 1;
+    munmap((void *) ((uintptr_t) qvm & ~page_mask), EXEC_STACK_RESERVE);
+}
+#else
+static struct qvm *new_vm(const size_t class)
+{
+    const size_t size = (size_t) 256 << class;
+    struct qvm *const qvm = calloc(1, size);
+
+    if (qvm) {
+        qvm->stack_size = size - sizeof(struct qvm);
+        note_heap(qvm, size);
+    }
+
+    return qvm;
+}
+
+static void delete_vm(struct qvm *const qvm)
+{
+    free(qvm);
+}
+#endif
+
+/* the class of VMs with at least `stack_size` bytes of stack, 0 for any size */
+static size_t pool_class(const uint64_t stack_size)
+{
+    size_t class = 0;
+
+    if (!stack_size) {
+        return POOL_CLASS_COUNT - 1;
+    }
+
+    while (class < POOL_CLASS_COUNT - 1 && sizeof(struct qvm) + stack_size > (size_t) 256 << class) {
+        class++;
+    }
+
+    return class;
+}
+
+#ifdef EXEC_RECLAIM
+/* puts `qvm` first on the children of `owner`, started in the frame at `bp` */
+static void own(struct qvm *const owner, struct qvm *const qvm, const uint64_t bp)
+{
+    qvm->owner = owner;
+    qvm->owner_bp = bp;
+    qvm->newer = NULL;
+
+    if ((qvm->older = owner->children)) {
+        owner->children->newer = qvm;
+    }
+
+    owner->children = qvm;
+}
+
+static void unlink_child(struct qvm *const qvm)
+{
+    if (qvm->newer) {
+        qvm->newer->older = qvm->older;
+    } else {
+        qvm->owner->children = qvm->older;
+    }
+
+    if (qvm->older) {
+        qvm->older->newer = qvm->newer;
+    }
+
+    qvm->older = qvm->newer = NULL;
+}
+
+static void disown(struct qvm *const qvm)
+{
+    if (qvm->owner) {
+        unlink_child(qvm);
+        qvm->owner = NULL;
+    }
+}
+
+/* every allocated VM, owned or not, newest first */
+static struct qvm *live_vms;
+
+static void link_live(struct qvm *const qvm)
+{
+    qvm->prev_live = NULL;
+
+    if ((qvm->next_live = live_vms)) {
+        live_vms->prev_live = qvm;
+    }
+
+    live_vms = qvm;
+}
+
+static void unlink_live(struct qvm *const qvm)
+{
+    if (qvm->prev_live) {
+        qvm->prev_live->next_live = qvm->next_live;
+    } else {
+        live_vms = qvm->next_live;
+    }
+
+    if (qvm->next_live) {
+        qvm->next_live->prev_live = qvm->prev_live;
+    }
+}
+#endif
+
+/* a VM with a stack of at least `stack_size` bytes, STACK_SIZE if unknown (0) */
+static struct qvm *alloc_vm(const uint64_t stack_size)
+{
+    const size_t class = pool_class(stack_size);
+    struct qvm *qvm = pool.free[class];
+
+    if (qvm) {
+        const uint64_t qvm_stack_size = qvm->stack_size;
+        pool.free[class] = qvm->parent;
+        pool.count--;
+        memset(qvm, 0, sizeof(struct qvm));
+        qvm->stack_size = qvm_stack_size;
+#ifdef EXEC_QVM_STATS
+        pool.reuses++;
+#endif
+    } else if (unlikely(!(qvm = new_vm(class)))) {
+        return NULL;
+    }
+
+#ifdef EXEC_QVM_STATS
+    pool.allocs++;
+
+    if (++pool.live > pool.peak_live) {
+        pool.peak_live = pool.live;
+    }
+#endif
+#ifdef EXEC_RECLAIM
+    link_live(qvm);
+#endif
+
+    return qvm;
+}
+
+static void free_vm(struct qvm *const qvm)
+{
+    if (qvm->parked) {
+        unpark(qvm);
+    }
+
+#ifdef EXEC_RECLAIM
+    unlink_live(qvm);
+    disown(qvm);
+
+    while (qvm->children) {
+        disown(qvm->children);
+    }
+#endif
+
+#ifdef CODEGEN_HEAP_TEMPS
+    free_temps(qvm);
+#endif
+#ifdef EXEC_QVM_STATS
+    pool.releases++;
+    pool.live--;
+#endif
+
+    if (pool.count < EXEC_QVM_POOL_MAX) {
+        const size_t class = pool_class(qvm->stack_size);
+        qvm->parent = pool.free[class];
+        pool.free[class] = qvm;
+        pool.count++;
+    } else {
+#ifdef EXEC_QVM_STATS
+        pool.frees++;
+#endif
+        delete_vm(qvm);
+    }
+}
+
+static void drain_pool(void)
+{
+    for (size_t class = 0; class < POOL_CLASS_COUNT; ++class) {
+        while (pool.free[class]) {
+            struct qvm *const qvm = pool.free[class];
+            pool.free[class] = qvm->parent;
+            delete_vm(qvm);
+        }
+    }
+
+    pool.count = 0;
+}
+
+#ifdef EXEC_QVM_STATS
+static void print_pool_stats(void)
+{
+    fprintf(stderr, "VMs: %" PRIu64 " allocated (%" PRIu64 " recycled), %" PRIu64
+        " released (%" PRIu64 " freed), %" PRIu64 " live at most, %" PRIu64 " pooled\n",
+        pool.allocs, pool.reuses, pool.releases, pool.frees, pool.peak_live, pool.count);
+}
+#endif
+
+#ifdef EXEC_RECLAIM
+/*
+ * Reclamation of orphaned quaints: every quaint is on the children of the VM
+ * that started it, newest first, along with the base of the frame that did.
+ * When a frame returns, the quaints started in it and not reaped, along with
+ * everything they started, are freed unless a root holds their handle: the
+ * returned value, the globals, the stack of every other VM (see link_live()),
+ * the stack of a quaint that is held itself, and every block the program has
+ * allocated (see heap_alloc()). The held ones pass on to the caller, or to the VM that
+ * waits for the returning one if that is its last frame.
+ */
+static struct qvm **orphans; /* by address */
+static size_t orphan_count, orphan_capacity;
+static uint64_t reclaimed;
+
+static int cmp_orphans(const void *const a, const void *const b)
+{
+    const uintptr_t x = (uintptr_t) *(struct qvm *const *) a;
+    const uintptr_t y = (uintptr_t) *(struct qvm *const *) b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_owner_bps(const void *const a, const void *const b)
+{
+    const uint64_t x = (*(struct qvm *const *) a)->owner_bp;
+    const uint64_t y = (*(struct qvm *const *) b)->owner_bp;
+    return x < y ? -1 : x > y;
+}
+
+static struct qvm *find_orphan(const uint64_t handle)
+{
+    if (handle < (uintptr_t) orphans[0] || handle > (uintptr_t) orphans[orphan_count - 1]) {
+        return NULL;
+    }
+
+    const struct qvm *const key = (const struct qvm *) (uintptr_t) handle;
+    struct qvm *const *const found = bsearch(&key, orphans, orphan_count,
+        sizeof(*orphans), cmp_orphans);
+
+    return found ? *found : NULL;
+}
+
+/* holds the orphans whose handles are in mem[0, size) */
+static void hold_orphans(const uint8_t *const mem, const uint64_t size)
+{
+    for (uint64_t off = 0; off + 8 <= size; off += 8) {
+        uint64_t handle;
+        memcpy(&handle, mem + off, 8);
+        struct qvm *const orphan = find_orphan(handle);
+
+        if (orphan) {
+            orphan->held = true;
+        }
+    }
+}
+
+/* the stack and the temporaries of `qvm`, or its value at its end */
+static void hold_from_vm(const struct qvm *const qvm)
+{
+    hold_orphans(qvm->stack, qvm->at_end && qvm->sp < 16 ? 16 : qvm->sp);
+
+#ifdef CODEGEN_HEAP_TEMPS
+    for (const struct tmp_chunk *chunk = qvm->tmp_chunk ? qvm->tmp_chunks : NULL;
+        chunk; chunk = chunk == qvm->tmp_chunk ? NULL : chunk->next) {
+
+        hold_orphans(chunk->mem, chunk->top);
+    }
+#endif
+}
+
+static bool reserve_orphan(void)
+{
+    if (orphan_count == orphan_capacity) {
+        const size_t capacity = orphan_capacity ? 2 * orphan_capacity : 64;
+        struct qvm **const grown = realloc(orphans, capacity * sizeof(*orphans));
+
+        if (unlikely(!grown)) {
+            return false;
+        }
+
+        orphans = grown;
+        orphan_capacity = capacity;
+    }
+
+    return true;
+}
+
+/*
+ * Reclaims what `owner` has started in the frames from `bp` on, the held
+ * quaints passing on to `heir` (unless NULL) as started in its frame at
+ * `heir_bp`.
+ */
+static void reclaim(struct qvm *const owner, const uint64_t bp,
+    const void *const retval, const uint64_t retval_size,
+    struct qvm *const heir, const uint64_t heir_bp)
+{
+    bool hold_all = false;
+    orphan_count = 0;
+
+    while (owner->children && owner->children->owner_bp >= bp && !hold_all) {
+        if ((hold_all = !reserve_orphan())) {
+            break;
+        }
+
+        orphans[orphan_count++] = owner->children;
+        unlink_child(owner->children);
+    }
+
+    for (size_t idx = 0; idx < orphan_count && !hold_all; ++idx) {
+        while (orphans[idx]->children) {
+            if ((hold_all = !reserve_orphan())) {
+                break;
+            }
+
+            struct qvm *const child = orphans[idx]->children;
+            orphans[orphan_count++] = child;
+            unlink_child(child);
+        }
+    }
+
+    if (!orphan_count) {
+        return;
+    }
+
+    qsort(orphans, orphan_count, sizeof(*orphans), cmp_orphans);
+
+    if (hold_all) {
+        for (size_t idx = 0; idx < orphan_count; ++idx) {
+            orphans[idx]->held = true;
+        }
+    } else {
+        if (retval_size) {
+            hold_orphans(retval, retval_size);
+        }
+
+        hold_orphans(bss, bss_size);
+
+        for (const struct heap_block *block = heap_blocks.next; block != &heap_blocks;
+            block = block->next) {
+
+            hold_orphans((const uint8_t *) (block + 1), block->size);
+        }
+
+        for (const struct qvm *running = vm; running; running = running->parent) {
+            struct qvm *const orphan = find_orphan((uintptr_t) running);
+
+            if (orphan) {
+                orphan->held = true;
+            }
+        }
+
+        /* a suspended quaint may have had a handle stored in it through a pointer */
+        for (const struct qvm *live = live_vms; live; live = live->next_live) {
+            if (!find_orphan((uintptr_t) live)) {
+                hold_from_vm(live);
+            }
+        }
+
+        for (bool more = true; more; ) {
+            more = false;
+
+            for (size_t idx = 0; idx < orphan_count; ++idx) {
+                if (orphans[idx]->held && !orphans[idx]->scanned) {
+                    orphans[idx]->scanned = more = true;
+                    hold_from_vm(orphans[idx]);
+                }
+            }
+        }
+    }
+
+    /* a held quaint stays with its owner if that is held too */
+    for (size_t idx = 0; idx < orphan_count; ++idx) {
+        struct qvm *const orphan = orphans[idx];
+
+        if (orphan->held && (orphan->owner == owner || !orphan->owner->held)) {
+            orphan->owner = heir;
+            orphan->owner_bp = heir_bp;
+        }
+    }
+
+    size_t held_count = 0;
+
+    for (size_t idx = 0; idx < orphan_count; ++idx) {
+        struct qvm *const orphan = orphans[idx];
+
+        if (orphan->held) {
+            orphans[held_count++] = orphan;
+        } else {
+            orphan->owner = NULL;
+            free_vm(orphan);
+            reclaimed++;
+        }
+    }
+
+    /* the oldest frames first, so that the children stay in their order */
+    qsort(orphans, held_count, sizeof(*orphans), cmp_owner_bps);
+
+    for (size_t idx = 0; idx < held_count; ++idx) {
+        struct qvm *const orphan = orphans[idx];
+        orphan->held = orphan->scanned = false;
+
+        if (orphan->owner) {
+            own(orphan->owner, orphan, orphan->owner_bp);
+        }
+    }
+
+    orphan_count = 0;
+}
+
+static uint64_t count_owned(const struct qvm *const owner)
+{
+    uint64_t count = 0;
+
+    for (const struct qvm *child = owner->children; child; child = child->older) {
+        count += 1 + count_owned(child);
+    }
+
+    return count;
+}
+
+static void free_owned(struct qvm *const owner)
+{
+    while (owner->children) {
+        struct qvm *const child = owner->children;
+        free_owned(child);
+        free_vm(child);
+    }
+}
+#endif
+
+#ifdef EXEC_TASKS
+/*
+ * Tasks: a spawned quaint is pushed on the work-stealing deque of the thread
+ * that spawned it, the main thread's being the first. A thread takes the
+ * tasks it spawned from the bottom of its deque, and steals from the top of
+ * the other ones when it runs out. A thread which reaps a task that has not
+ * ended yet runs other tasks meanwhile, so nested tasks never all sleep.
+ *
+ * Spawning a quaint happens before anything it does, and its end happens
+ * before it is reaped or seen at its end. Otherwise the data segment is
+ * shared unsynchronised: tasks accessing the same globals race.
+ */
+#define TASK_SPAWNED 1
+#define TASK_DONE 2
+
+/* a power of 2, a quaint spawned on a full deque stays where it is */
+#ifndef EXEC_TASK_DEQUE_SIZE
+#define EXEC_TASK_DEQUE_SIZE 1024
+#endif
+
+struct task_deque {
+    int64_t top, bottom;
+    struct qvm *tasks[EXEC_TASK_DEQUE_SIZE];
+} __attribute__((aligned(64)));
+
+static struct {
+    struct task_deque *deques;
+    pthread_t *threads;
+    uint32_t count, started; /* threads, including the main one */
+
+    /* accessed atomically */
+    uint32_t queued, sleeping, running, stopping;
+    int error; /* of the first task that failed */
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed; /* a task was queued or has ended, or the pool stops */
+} tasks = { .lock = PTHREAD_MUTEX_INITIALIZER, .changed = PTHREAD_COND_INITIALIZER };
+
+/* by the owner of the deque only, false if it is full */
+static bool push_task(struct task_deque *const deque, struct qvm *const task)
+{
+    const int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    const int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+    if (bottom - top >= EXEC_TASK_DEQUE_SIZE) {
+        return false;
+    }
+
+    __atomic_store_n(&deque->tasks[bottom & (EXEC_TASK_DEQUE_SIZE - 1)], task, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* by the owner of the deque only, the task it spawned last */
+static struct qvm *pop_task(struct task_deque *const deque)
+{
+    const int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+    struct qvm *task = NULL;
+
+    if (top <= bottom) {
+        task = __atomic_load_n(&deque->tasks[bottom & (EXEC_TASK_DEQUE_SIZE - 1)],
+            __ATOMIC_RELAXED);
+
+        if (top < bottom) {
+            return task;
+        }
+
+        /* the last one, which a thief may be taking at the same time */
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+
+            task = NULL;
+        }
+    }
+
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return task;
+}
+
+/* by any other thread, the task spawned first, NULL if there is none or it lost a race */
+static struct qvm *steal_task(struct task_deque *const deque)
+{
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom) {
+        return NULL;
+    }
+
+    struct qvm *const task = __atomic_load_n(
+        &deque->tasks[top & (EXEC_TASK_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+
+    return __atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) ? task : NULL;
+}
+
+static void notify_tasks(void)
+{
+    if (__atomic_load_n(&tasks.sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&tasks.lock);
+        pthread_cond_broadcast(&tasks.changed);
+        pthread_mutex_unlock(&tasks.lock);
+    }
+}
+
+/* a queued task for the thread to run, its own ones first */
+static struct qvm *find_task(void)
+{
+    struct qvm *task = pop_task(&tasks.deques[task_self]);
+
+    for (uint32_t step = 1; !task && step < tasks.count; ++step) {
+        task = steal_task(&tasks.deques[(task_self + step) % tasks.count]);
+    }
+
+    if (task) {
+        __atomic_sub_fetch(&tasks.queued, 1, __ATOMIC_SEQ_CST);
+    }
+
+    return task;
+}
+
+/*
+ * Sleeps until a task is queued, the pool stops or, if given, the task has
+ * ended or the deadline (0 for none) is due.
+ */
+static void await_tasks(const struct qvm *const task, const uint64_t deadline)
+{
+    struct timespec until;
+
+    if (deadline) {
+        clock_gettime(CLOCK_REALTIME, &until);
+
+        const uint64_t left = deadline > now ? deadline - now : 0;
+        const uint64_t nsec = (uint64_t) until.tv_nsec + left % 1000000000;
+        until.tv_sec += (time_t) (left / 1000000000 + nsec / 1000000000);
+        until.tv_nsec = (long) (nsec % 1000000000);
+    }
+
+    flush_output();
+    pthread_mutex_lock(&tasks.lock);
+    __atomic_add_fetch(&tasks.sleeping, 1, __ATOMIC_SEQ_CST);
+
+    while (!__atomic_load_n(&tasks.queued, __ATOMIC_SEQ_CST) &&
+        !__atomic_load_n(&tasks.stopping, __ATOMIC_SEQ_CST) &&
+        !(task && __atomic_load_n(&task->task, __ATOMIC_SEQ_CST) == TASK_DONE)) {
+
+        if (!deadline) {
+            pthread_cond_wait(&tasks.changed, &tasks.lock);
+        } else if (pthread_cond_timedwait(&tasks.changed, &tasks.lock, &until) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    __atomic_sub_fetch(&tasks.sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&tasks.lock);
+}
+
+static int run(void);
+
+/*
+ * Runs the task on this thread, in the middle of whatever it was running. A
+ * task thread is no longer counted as running once no program code is left
+ * for it to run, or else the program could not end right after reaping.
+ */
+static void run_task(struct qvm *const task, const bool uncount)
+{
+    struct qvm *const old_vm = vm;
+    const uint64_t old_deadline = armed_deadline;
+    const bool old_passed = deadline_passed, old_blocked = deadline_blocked;
+
+    vm = task;
+    armed_deadline = 0;
+    deadline_passed = 0;
+    deadline_blocked = false;
+
+    const int error = run();
+
+    if (unlikely(error)) {
+        int none = EXEC_OK;
+
+        __atomic_compare_exchange_n(&tasks.error, &none, error, false,
+            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+
+    if (!get_monotonic_time(&now)) {
+        arm_deadline(old_deadline);
+    }
+
+    deadline_passed = deadline_passed || old_passed;
+    deadline_blocked = old_blocked;
+    vm = old_vm;
+
+    if (uncount) {
+        __atomic_sub_fetch(&tasks.running, 1, __ATOMIC_SEQ_CST);
+    }
+
+    __atomic_store_n(&task->task, TASK_DONE, __ATOMIC_SEQ_CST);
+    notify_tasks();
+}
+
+/*
+ * Runs other tasks until the spawned quaint has ended, or sleeps until then
+ * or until the deadline (0 for none) is due, as a task could outlast it.
+ */
+static int join_task(const struct qvm *const qvm, const uint64_t deadline)
+{
+    while (__atomic_load_n(&qvm->task, __ATOMIC_ACQUIRE) != TASK_DONE) {
+        struct qvm *const task = deadline ? NULL : find_task();
+
+        if (task) {
+            run_task(task, false);
+            continue;
+        }
+
+        if (deadline) {
+            if (unlikely(get_monotonic_time(&now))) {
+                return EXEC_NOMEM;
+            }
+
+            if (now >= deadline) {
+                break;
+            }
+        }
+
+        await_tasks(qvm, deadline);
+    }
+
+    return __atomic_load_n(&tasks.error, __ATOMIC_SEQ_CST);
+}
+
+static void *task_thread(void *const arg)
+{
+    task_self = (uint32_t) (uintptr_t) arg;
+
+    for (;;) {
+        /* counted before looking at `stopping`, see stop_tasks() */
+        __atomic_add_fetch(&tasks.running, 1, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&tasks.stopping, __ATOMIC_SEQ_CST)) {
+            __atomic_sub_fetch(&tasks.running, 1, __ATOMIC_SEQ_CST);
+            break;
+        }
+
+        struct qvm *const task = find_task();
+
+        if (task) {
+            run_task(task, true);
+        } else {
+            __atomic_sub_fetch(&tasks.running, 1, __ATOMIC_SEQ_CST);
+            await_tasks(NULL, 0);
+        }
+    }
+
+    flush_output();
+    free_fd_buffers();
+    free_reactor();
+    drain_pool();
+    return NULL;
+}
+
+/* a thread per CPU but the main thread, which runs tasks when it reaps them */
+static int start_tasks(void)
+{
+    const long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const uint32_t count = ncpus > 2 ? (uint32_t) ncpus : 2;
+
+    if (!(tasks.deques = aligned_alloc(64, count * sizeof(*tasks.deques))) ||
+        !(tasks.threads = calloc(count, sizeof(*tasks.threads)))) {
+
+        free(tasks.deques);
+        tasks.deques = NULL;
+        return EXEC_NOMEM;
+    }
+
+    memset(tasks.deques, 0, count * sizeof(*tasks.deques));
+    tasks.count = count;
+
+    /* the timer signal is left to the main thread */
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+
+    /* with fewer threads, the tasks just run when reaped */
+    for (tasks.started = 1; tasks.started < count; ++tasks.started) {
+        if (pthread_create(&tasks.threads[tasks.started], NULL, task_thread,
+            (void *) (uintptr_t) tasks.started)) {
+
+            break;
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    return EXEC_OK;
+}
+
+/* false if a thread still runs a task, which needs the program to stay around */
+static bool stop_tasks(void)
+{
+    if (!tasks.count) {
+        return true;
+    }
+
+    __atomic_store_n(&tasks.stopping, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&tasks.lock);
+    pthread_cond_broadcast(&tasks.changed);
+    pthread_mutex_unlock(&tasks.lock);
+
+    if (__atomic_load_n(&tasks.running, __ATOMIC_SEQ_CST)) {
+        return false;
+    }
+
+    for (uint32_t idx = 1; idx < tasks.started; ++idx) {
+        pthread_join(tasks.threads[idx], NULL);
+    }
+
+    free(tasks.threads);
+    free(tasks.deques);
+    tasks.threads = NULL;
+    tasks.deques = NULL;
+    tasks.count = tasks.started = 0;
+    return true;
+}
+
+/* hands a quaint that has not started yet over to the threads */
+static int spawn(struct qvm *const qvm)
+{
+    if (!tasks.count && unlikely(start_tasks())) {
+        return EXEC_NOMEM;
+    }
+
+    qvm->parent = NULL;
+    qvm->may_split = 0;
+    __atomic_store_n(&qvm->task, TASK_SPAWNED, __ATOMIC_RELAXED);
+
+    if (!push_task(&tasks.deques[task_self], qvm)) {
+        __atomic_store_n(&qvm->task, 0, __ATOMIC_RELAXED);
+        return EXEC_OK;
+    }
+
+    __atomic_add_fetch(&tasks.queued, 1, __ATOMIC_SEQ_CST);
+    notify_tasks();
+    return EXEC_OK;
+}
+#endif
+
+static int handle_return(const struct exec_insn *insn,
+    const uint64_t retval_size, const void *const retval)
+{
+    if (vm->sp == 0 && vm->parent) {
+        insn = &insns[vm->parent->ip];
+
+#ifdef EXEC_RECLAIM
+        if (vm->children) {
+            reclaim(vm, 0, retval, retval_size, vm->parent, vm->parent->bp);
+        }
+#endif
+
+        SAFE_LEGAL_IF(insn->op == (retval_size ? CODEGEN_OP_RTEV : CODEGEN_OP_RTE) ||
+            insn->op == CODEGEN_OP_WAIT, "");
+
+        switch (insn->op) {
+        case CODEGEN_OP_RTEV: {
+            struct qvm *const old_vm = vm;
+            vm = vm->parent;
+            const uint64_t cval_size = opd_size(&insn->un.dst);
+            void *const cval = opd_val(&insn->un.dst);
+
+            SAFE_LEGAL_IF(retval_size == cval_size, "%" PRIu64 ", %" PRIu64,
+                retval_size, cval_size);
+
+            memcpy(cval, retval, (size_t) cval_size);
+            free_vm(old_vm);
+            *(uint64_t *) opd_val(&insn->un.src) = 0;
+        } break;
+
+        case CODEGEN_OP_RTE: {
+            struct qvm *const old_vm = vm;
+            vm = vm->parent;
+            free_vm(old_vm);
+            *(uint64_t *) opd_val(&insn->un.src) = 0;
+        } break;
+
+        case CODEGEN_OP_WAIT: {
+            vm->at_end = 1;
+            vm->last_passed = 0;
+
+            if (retval_size) {
+                memmove(vm->stack, retval, (size_t) retval_size);
+            }
+
+#ifdef CODEGEN_HEAP_TEMPS
+            free_temps(vm);
+#endif
+            vm = vm->parent;
+            end_wait(vm, vm->any_current);
+        } break;
+        }
+
+        vm->ip++;
+    } else if (vm->sp == 0) {
+#ifdef EXEC_TASKS
+        /* a task that has ended, see run_task() */
+        if (__atomic_load_n(&vm->task, __ATOMIC_RELAXED)) {
+            vm->at_end = 1;
+            vm->last_passed = 0;
+
+            if (retval_size) {
+                memmove(vm->stack, retval, (size_t) retval_size);
+            }
+
+#ifdef CODEGEN_HEAP_TEMPS
+            free_temps(vm);
+#endif
+            vm->ip = o->insn_count;
+            return EXEC_OK;
+        }
+#endif
+
+        const int status = retval_size ? exit_status_from_retval(insn) : 0;
+#ifdef EXEC_RECLAIM
+        if (vm->children) {
+            reclaim(vm, 0, retval, retval_size, vm, 0);
+        }
+#endif
+#ifdef CODEGEN_HEAP_TEMPS
+        vm->temps = NULL;
+#endif
+        vm->ip = *(uint64_t *) (vm->stack + vm->sp);
+        vm->bp = *(uint64_t *) (vm->stack + vm->sp + 8);
+        return status;
+    } else {
+#ifdef EXEC_RECLAIM
+        const uint64_t frame_bp = vm->bp;
+#endif
+#ifdef CODEGEN_HEAP_TEMPS
+        pop_temps();
+#endif
+        vm->ip = *(uint64_t *) (vm->stack + vm->sp);
+        vm->bp = *(uint64_t *) (vm->stack + vm->sp + 8);
+
+#ifdef EXEC_RECLAIM
+        if (unlikely(vm->children && vm->children->owner_bp >= frame_bp)) {
+            reclaim(vm, frame_bp, retval, retval_size, vm, vm->bp);
+        }
+#endif
+
+        SAFE_LEGAL_IF(vm->ip < o->insn_count, "%" PRIu64, vm->ip);
+        SAFE_LEGAL_IF(vm->bp <= vm->stack_size, "%" PRIu64, vm->bp);
+
+        if (retval_size) {
+            insn = &insns[vm->ip];
+            SAFE_LEGAL_IF(insn->op == CODEGEN_OP_CALLV, "");
+            const uint64_t cval_size = opd_size(&insn->call.val);
+
+            SAFE_LEGAL_IF(retval_size == cval_size, "%" PRIu64 ", %" PRIu64,
+                retval_size, cval_size);
+
+            void *const cval = opd_val(&insn->call.val);
+            memcpy(cval, retval, (size_t) cval_size);
+        }
+
+        vm->ip++;
+    }
+
+    return EXEC_OK;
+}
+
+static int insn_mov(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_MOV);
+
+    const uint64_t dst_size = opd_size(&insn->un.dst);
+    void *const dst = opd_val(&insn->un.dst);
+    const void *const src = opd_val(&insn->un.src);
+
+    memcpy(dst, src, (size_t) dst_size);
+    return EXEC_OK;
+}
+
+static int insn_cast(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_CAST);
+
+    const uint64_t dst_size = opd_size(&insn->un.dst);
+    const uint64_t src_size = opd_size(&insn->un.src);
+
+    void *const dst = opd_val(&insn->un.dst);
+    const void *const src = opd_val(&insn->un.src);
+
+    memset(dst, 0, (size_t) dst_size);
+    memcpy(dst, src, src_size < dst_size ? (size_t) src_size : (size_t) dst_size);
+    return EXEC_OK;
+}
+
+static int insn_bin_arith(const struct exec_insn *const insn)
+{
+    const uint8_t signd = insn->bin.dst.signd;
+    const uint64_t dst_size = opd_size(&insn->bin.dst);
+
+    void *const dst = opd_val(&insn->bin.dst);
+    const void *const src1 = opd_val(&insn->bin.src1);
+    const void *const src2 = opd_val(&insn->bin.src2);
+
+    #define ARITH_OP(op) \
+    switch (dst_size) { \
+    case 1: \
+        if (signd) { \
+            *(int8_t *) dst = (int8_t) (*(int8_t *) src1 op *(int8_t *) src2); \
+        } else { \
+            *(uint8_t *) dst = (uint8_t) (*(uint8_t *) src1 op *(uint8_t *) src2); \
+        } \
+        break; \
+    \
+    case 2: \
+        if (signd) { \
+            *(int16_t *) dst = (int16_t) (*(int16_t *) src1 op *(int16_t *) src2); \
+        } else { \
+            *(uint16_t *) dst = (uint16_t) (*(uint16_t *) src1 op *(uint16_t *) src2); \
+        } \
+        break; \
+    \
+    case 4: \
+        if (signd) { \
+            *(int32_t *) dst = *(int32_t *) src1 op *(int32_t *) src2; \
+        } else { \
+            *(uint32_t *) dst = *(uint32_t *) src1 op *(uint32_t *) src2; \
+        } \
+        break; \
+    \
+    case 8: \
+        if (signd) { \
+            *(int64_t *) dst = *(int64_t *) src1 op *(int64_t *) src2; \
+        } else { \
+            *(uint64_t *) dst = *(uint64_t *) src1 op *(uint64_t *) src2; \
+        } \
+        break; \
+    }
+
+    switch (insn->op) {
+    case CODEGEN_OP_ADD: ARITH_OP( +); break;
+    case CODEGEN_OP_SUB: ARITH_OP( -); break;
+    case CODEGEN_OP_MUL: ARITH_OP( *); break;
+    case CODEGEN_OP_DIV: ARITH_OP( /); break;
+    case CODEGEN_OP_MOD: ARITH_OP( %); break;
+    case CODEGEN_OP_LSH: ARITH_OP(<<); break;
+    case CODEGEN_OP_RSH: ARITH_OP(>>); break;
+    case CODEGEN_OP_AND: ARITH_OP( &); break;
+    case CODEGEN_OP_XOR: ARITH_OP( ^); break;
+    case CODEGEN_OP_OR:  ARITH_OP( |); break;
+    default: assert(0), abort();
+    }
+
+    #undef ARITH_OP
+    return EXEC_OK;
+}
+
+static int insn_equ_neq(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_EQU || insn->op == CODEGEN_OP_NEQ);
+
+    const uint64_t src1_size = opd_size(&insn->bin.src1);
+
+    uint8_t *const dst = opd_val(&insn->bin.dst);
+    const void *const src1 = opd_val(&insn->bin.src1);
+    const void *const src2 = opd_val(&insn->bin.src2);
+
+    const int equal = !memcmp(src1, src2, (size_t) src1_size);
+    *dst = insn->op == CODEGEN_OP_EQU ? (equal ? 1 : 0) : !equal;
+    return EXEC_OK;
+}
+
+static int insn_bin_logic(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_LT || insn->op == CODEGEN_OP_GT ||
+        insn->op == CODEGEN_OP_LTE || insn->op == CODEGEN_OP_GTE);
+
+    const uint8_t src1_signd = insn->bin.src1.signd;
+    const uint64_t src1_size = opd_size(&insn->bin.src1);
+
+    uint8_t *const dst = opd_val(&insn->bin.dst);
+    const void *const src1 = opd_val(&insn->bin.src1);
+    const void *const src2 = opd_val(&insn->bin.src2);
+
+    #define LOGIC_OP(op) \
+    switch (src1_size) { \
+    case 1: \
+        if (src1_signd) { \
+            *dst = *(int8_t *) src1 op *(int8_t *) src2; \
+        } else { \
+            *dst = *(uint8_t *) src1 op *(uint8_t *) src2; \
+        } \
+        break; \
+    \
+    case 2: \
+        if (src1_signd) { \
+            *dst = *(int16_t *) src1 op *(int16_t *) src2; \
+        } else { \
+            *dst = *(uint16_t *) src1 op *(uint16_t *) src2; \
+        } \
+        break; \
+    \
+    case 4: \
+        if (src1_signd) { \
+            *dst = *(int32_t *) src1 op *(int32_t *) src2; \
+        } else { \
+            *dst = *(uint32_t *) src1 op *(uint32_t *) src2; \
+        } \
+        break; \
+    \
+    case 8: \
+        if (src1_signd) { \
+            *dst = *(int64_t *) src1 op *(int64_t *) src2; \
+        } else { \
+            *dst = *(uint64_t *) src1 op *(uint64_t *) src2; \
+        } \
+        break; \
+    }
+
+    switch (insn->op) {
+    case CODEGEN_OP_LT:  LOGIC_OP( <); break;
+    case CODEGEN_OP_GT:  LOGIC_OP( >); break;
+    case CODEGEN_OP_LTE: LOGIC_OP(<=); break;
+    case CODEGEN_OP_GTE: LOGIC_OP(>=); break;
+    default: assert(0), abort();
+    }
+
+    #undef LOGIC_OP
+    return EXEC_OK;
+}
+
+static int insn_not(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_NOT);
+
+    const uint8_t dst_signd = insn->un.dst.signd;
+    const uint64_t dst_size = opd_size(&insn->un.dst);
+
+    void *const dst = opd_val(&insn->un.dst);
+    const void *const src = opd_val(&insn->un.src);
+
+    switch (dst_size) {
+    case 1:
+        if (dst_signd) {
+            *(int8_t *) dst = !*(int8_t *) src;
+        } else {
+            *(uint8_t *) dst = !*(uint8_t *) src;
+        }
+        break;
+
+    case 2:
+        if (dst_signd) {
+            *(int16_t *) dst = !*(int16_t *) src;
+        } else {
+            *(uint16_t *) dst = !*(uint16_t *) src;
+        }
+        break;
+
+    case 4:
+        if (dst_signd) {
+            *(int32_t *) dst = !*(int32_t *) src;
+        } else {
+            *(uint32_t *) dst = !*(uint32_t *) src;
+        }
+        break;
+
+    case 8:
+        if (dst_signd) {
+            *(int64_t *) dst = !*(int64_t *) src;
+        } else {
+            *(uint64_t *) dst = !*(uint64_t *) src;
+        }
+        break;
+    }
+
+    return EXEC_OK;
+}
+
+static int insn_neg(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_NEG);
+
+    const uint64_t dst_size = opd_size(&insn->un.dst);
+    const uint8_t src_signd = insn->un.src.signd;
+
+    void *const dst = opd_val(&insn->un.dst);
+    const void *const src = opd_val(&insn->un.src);
+
+    switch (dst_size) {
+    case 1:
+        if (src_signd) {
+            *(int8_t *) dst = (int8_t) -*(int8_t *) src;
+        } else {
+            *(int8_t *) dst = (int8_t) -*(uint8_t *) src;
+        }
+        break;
+
+    case 2:
+        if (src_signd) {
+            *(int16_t *) dst = (int16_t) -*(int16_t *) src;
+        } else {
+            *(int16_t *) dst = (int16_t) -*(uint16_t *) src;
+        }
+        break;
+
+    case 4:
+        if (src_signd) {
+            *(int32_t *) dst = -*(int32_t *) src;
+        } else {
+            *(int32_t *) dst = (int32_t) -*(uint32_t *) src;
+        }
+        break;
+
+    case 8:
+        if (src_signd) {
+            *(int64_t *) dst = -*(int64_t *) src;
+        } else {
+            *(int64_t *) dst = (int64_t) -*(uint64_t *) src;
+        }
+        break;
+    }
+
+    return EXEC_OK;
+}
+
+static int insn_bneg(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_BNEG);
+
+    const uint64_t dst_size = opd_size(&insn->un.dst);
+
+    void *const dst = opd_val(&insn->un.dst);
+    const void *const src = opd_val(&insn->un.src);
+
+    switch (dst_size) {
+    case 1:
+        *(uint8_t *) dst = ~*(uint8_t *) src;
+        break;
+
+    case 2:
+        *(uint16_t *) dst = ~*(uint16_t *) src;
+        break;
+
+    case 4:
+        *(uint32_t *) dst = ~*(uint32_t *) src;
+        break;
+
+    case 8:
+        *(uint64_t *) dst = ~*(uint64_t *) src;
+        break;
+    }
+
+    return EXEC_OK;
+}
+
+static int insn_oz(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_OZ);
+
+    const uint8_t src_signd = insn->un.src.signd;
+    const uint64_t src_size = opd_size(&insn->un.src);
+
+    uint8_t *const dst = opd_val(&insn->un.dst);
+    const void *const src = opd_val(&insn->un.src);
+
+    switch (src_size) {
+    case 1:
+        *dst = src_signd ? (*(int8_t *) src ? 1 : 0) : (*(uint8_t *) src ? 1 : 0);
+        break;
+
+    case 2:
+        *dst = src_signd ? (*(int16_t *) src ? 1 : 0) : (*(uint16_t *) src ? 1 : 0);
+        break;
+
+    case 4:
+        *dst = src_signd ? (*(int32_t *) src ? 1 : 0) : (*(uint32_t *) src ? 1 : 0);
+        break;
+
+    case 8:
+        *dst = src_signd ? (*(int64_t *) src ? 1 : 0) : (*(uint64_t *) src ? 1 : 0);
+        break;
+    }
+
+    return EXEC_OK;
+}
+
+static int insn_inc_dec(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_INC || insn->op == CODEGEN_OP_DEC);
+
+    const uint8_t dst_signd = insn->dst.signd;
+    const uint64_t dst_size = opd_size(&insn->dst);
+
+    void *const dst = opd_val(&insn->dst);
+
+    #define INC_DEC_OP(op) \
+    switch (dst_size) { \
+    case 1: \
+        if (dst_signd) { \
+            (*(int8_t *) dst)op; \
+        } else { \
+            (*(uint8_t *) dst)op; \
+        } \
+        break; \
+    \
+    case 2: \
+        if (dst_signd) { \
+            (*(int16_t *) dst)op; \
+        } else { \
+            (*(uint16_t *) dst)op; \
+        } \
+        break; \
+    \
+    case 4: \
+        if (dst_signd) { \
+            (*(int32_t *) dst)op; \
+        } else { \
+            (*(uint32_t *) dst)op; \
+        } \
+        break; \
+    \
+    case 8: \
+        if (dst_signd) { \
+            (*(int64_t *) dst)op; \
+        } else { \
+            (*(uint64_t *) dst)op; \
+        } \
+        break; \
+    }
+
+    if (insn->op == CODEGEN_OP_INC) {
+        INC_DEC_OP(++);
+    } else {
+        INC_DEC_OP(--);
+    }
+
+    #undef INC_DEC_OP
+    return EXEC_OK;
+}
+
+static int insn_incp_decp(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_INCP || insn->op == CODEGEN_OP_DECP);
+
+    const uint8_t dst_signd = insn->un.dst.signd;
+    const uint64_t dst_size = opd_size(&insn->un.dst);
+
+    void *const dst = opd_val(&insn->un.dst);
+    void *const src = opd_val(&insn->un.src);
+
+    #define INCP_DECP_OP(op) \
+    switch (dst_size) { \
+    case 1: \
+        if (dst_signd) { \
+            *(int8_t *) dst = (*(int8_t *) src)op; \
+        } else { \
+            *(uint8_t *) dst = (*(uint8_t *) src)op; \
+        } \
+        break; \
+    \
+    case 2: \
+        if (dst_signd) { \
+            *(int16_t *) dst = (*(int16_t *) src)op; \
+        } else { \
+            *(uint16_t *) dst = (*(uint16_t *) src)op; \
+        } \
+        break; \
+    \
+    case 4: \
+        if (dst_signd) { \
+            *(int32_t *) dst = (*(int32_t *) src)op; \
+        } else { \
+            *(uint32_t *) dst = (*(uint32_t *) src)op; \
+        } \
+        break; \
+    \
+    case 8: \
+        if (dst_signd) { \
+            *(int64_t *) dst = (*(int64_t *) src)op; \
+        } else { \
+            *(uint64_t *) dst = (*(uint64_t *) src)op; \
+        } \
+        break; \
+    }
+
+    if (insn->op == CODEGEN_OP_INCP) {
+        INCP_DECP_OP(++);
+    } else {
+        INCP_DECP_OP(--);
+    }
+
+    #undef INCP_DECP_OP
+    return EXEC_OK;
+}
+
+static int insn_cjmp(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_JZ || insn->op == CODEGEN_OP_JNZ);
+
+    const uint64_t cond_size = opd_size(&insn->jmp.cond);
+    const void *const cond = opd_val(&insn->jmp.cond);
+    static const uint8_t zero_mem[128];
+    int all_zero;
+
+    if (unlikely(cond_size > 128)) {
+        void *const zero_alloc = calloc(1, (size_t) cond_size);
+
+        if (unlikely(!zero_alloc)) {
+            return EXEC_NOMEM;
+        }
+
+        all_zero = !memcmp(zero_alloc, cond, (size_t) cond_size);
+        free(zero_alloc);
+    } else {
+        all_zero = !memcmp(zero_mem, cond, (size_t) cond_size);
+    }
+
+    if (insn->op == CODEGEN_OP_JZ) {
+        if (all_zero) {
+            vm->ip = insn->jmp.loc;
+        } else {
+            vm->ip++;
+        }
+    } else {
+        if (all_zero) {
+            vm->ip++;
+        } else {
+            vm->ip = insn->jmp.loc;
+        }
+    }
+
+    return EXEC_OK;
+}
+
+static int insn_jmp(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_JMP);
+    vm->ip = insn->jmp.loc;
+    return EXEC_OK;
+}
+
+static int insn_pushr(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_PUSHR);
+
+    SAFE_LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
+    LEGAL_IF(vm->sp + 16 <= vm->stack_size, "%" PRIu64, vm->sp);
+
+    const uint64_t retip = imms[insn->push.val.off];
+    uint64_t *const ssp = opd_val(&insn->push.ssp);
+
+    *(uint64_t *) (vm->stack + vm->sp) = retip;
+    *(uint64_t *) (vm->stack + vm->sp + 8) = (uint64_t) vm->bp;
+
+    vm->sp += 16;
+    *ssp = vm->sp;
+
+    return EXEC_OK;
+}
+
+static int insn_push(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_PUSH);
+
+    const uint64_t val_size = opd_size(&insn->push.val);
+
+    SAFE_LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
+    LEGAL_IF(vm->sp + val_size <= vm->stack_size, "%" PRIu64 ", %" PRIu64, vm->sp, val_size);
+
+    const void *const val = opd_val(&insn->push.val);
+    memcpy(vm->stack + vm->sp, val, (size_t) val_size);
+    vm->sp += val_size;
+    ALIGN_UP(vm->sp, 8);
+    LEGAL_IF(vm->sp <= vm->stack_size, "%" PRIu64, vm->sp);
+
+    return EXEC_OK;
+}
+
+static int insn_call_callv(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_CALL || insn->op == CODEGEN_OP_CALLV);
+
+    const uint64_t *const loc = opd_val(&insn->call.loc);
+    const uint64_t *const bp = opd_val(&insn->call.bp);
+
+    vm->ip = *loc;
+    vm->bp = *bp;
+
+    return EXEC_OK;
+}
+
+static int insn_incsp(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_INCSP);
+
+    const uint64_t addend = imms[insn->incsp.addend.off];
+
+    vm->at_start = 0;
+    vm->sp += addend;
+    LEGAL_IF(vm->sp <= vm->stack_size, "%" PRIu64, vm->sp);
+    SAFE_LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
+
+#ifdef CODEGEN_HEAP_TEMPS
+    return push_temps(imms[insn->incsp.tsize.off]);
+#else
+    return EXEC_OK;
+#endif
+}
+
+static int insn_ret_retv(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_RET || insn->op == CODEGEN_OP_RETV);
+
+    SAFE_LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
+    SAFE_LEGAL_IF(vm->bp % 8 == 0, "%" PRIu64, vm->bp);
+
+    const uint64_t size = imms[insn->ret.size.off];
+
+    SAFE_LEGAL_IF(vm->sp >= size, "%" PRIu64 ", %" PRIu64, vm->sp, size);
+#ifdef CODEGEN_HEAP_TEMPS
+    SAFE_LEGAL_IF(vm->temps != NULL, "");
+#endif
+    vm->sp -= size;
+
+    const bool with_value = insn->op == CODEGEN_OP_RETV;
+    const uint64_t retval_size = with_value ? opd_size(&insn->ret.val) : 0;
+    const void *const retval = with_value ? opd_val(&insn->ret.val) : NULL;
+
+    return handle_return(insn, retval_size, retval);
+}
+
+static int insn_ref(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_REF);
+
+    uint64_t *const dst = opd_val(&insn->un.dst);
+    *dst = (uint64_t) (uintptr_t) opd_val(&insn->un.src);
+    return EXEC_OK;
+}
+
+static int insn_drf(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_DRF);
+
+    const uint64_t dst_size = opd_size(&insn->un.dst);
+    void *const dst = opd_val(&insn->un.dst);
+    const uint64_t *const src = opd_val(&insn->un.src);
+
+    memcpy(dst, (const void *) (uintptr_t) *src, (size_t) dst_size);
+    return EXEC_OK;
+}
+
+static int insn_rte_rtev(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_RTE || insn->op == CODEGEN_OP_RTEV);
+    const bool with_value = insn->op == CODEGEN_OP_RTEV;
+
+    uint64_t dst_size;
+    void *dst;
+
+    if (with_value) {
+        dst_size = opd_size(&insn->un.dst);
+        dst = opd_val(&insn->un.dst);
+    }
+
+    const uint64_t handle = *(uint64_t *) opd_val(&insn->un.src);
+    struct qvm *const qvm = (struct qvm *) (uintptr_t) handle;
+
+    if (!qvm) {
+        if (with_value) {
+            memset(dst, 0, (size_t) dst_size);
+        }
+
+        return vm->ip++, EXEC_OK;
+    }
+
+    if (handle & QVAL_MASK) {
+        if (with_value) {
+            qval_get(handle, dst, dst_size);
+        }
+
+        qval_free(handle);
+        *(uint64_t *) opd_val(&insn->un.src) = 0;
+        return vm->ip++, EXEC_OK;
+    }
+
+#ifdef EXEC_TASKS
+    if (__atomic_load_n(&qvm->task, __ATOMIC_ACQUIRE)) {
+        const int error = join_task(qvm, 0);
+
+        if (unlikely(error)) {
+            return error;
+        }
+    }
+#endif
+
+    if (qvm->at_end) {
+        if (with_value) {
+            memcpy(dst, qvm->stack, (size_t) dst_size);
+        }
+
+        free_vm(qvm);
+        *(uint64_t *) opd_val(&insn->un.src) = 0;
+        return vm->ip++, EXEC_OK;
+    }
+
+    qvm->parent = vm;
+    qvm->may_split = vm->may_split;
+    vm = qvm;
+    return EXEC_OK;
+}
+
+static int insn_qat(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_QAT);
+
+    uint8_t *const dst = opd_val(&insn->qat.dst);
+    const uint64_t handle = *(uint64_t *) opd_val(&insn->qat.quaint);
+    struct qvm *const qvm = (struct qvm *) (uintptr_t) handle;
+
+    if (!qvm) {
+        *dst = 0;
+    } else if (handle & QVAL_MASK) {
+        *dst = !insn->qat.label || labels[insn->qat.label].func == 1;
+#ifdef EXEC_TASKS
+    } else if (__atomic_load_n(&qvm->task, __ATOMIC_ACQUIRE)) {
+        /* only the end of a spawned quaint can be seen from outside */
+        *dst = insn->qat.label && labels[insn->qat.label].func == 1 &&
+            __atomic_load_n(&qvm->task, __ATOMIC_ACQUIRE) == TASK_DONE;
+#endif
+    } else if (!insn->qat.label) {
+        *dst = qvm->at_start;
+    } else if (labels[insn->qat.label].func == 1) {
+        *dst = qvm->at_end;
+    } else {
+        *dst = qvm->last_passed == insn->qat.label;
+    }
+
+    return EXEC_OK;
+}
+
+static int insn_wait(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_WAIT);
+
+    uint64_t handle = *(uint64_t *) opd_val(&insn->wait.quaint);
+    uint32_t count = 0, current = 0;
+
+    /* without EXEC_TASKS, a spawned quaint just runs when waited for or reaped */
+    if (insn->wait.spawn) {
+#ifdef EXEC_TASKS
+        struct qvm *const qvm = (struct qvm *) (uintptr_t) handle;
+
+        if (qvm && !(handle & QVAL_MASK) &&
+            !__atomic_load_n(&qvm->task, __ATOMIC_RELAXED) && qvm->at_start) {
+
+            const int error = spawn(qvm);
+
+            if (unlikely(error)) {
+                return error;
+            }
+        }
+#endif
+        return vm->ip++, EXEC_OK;
+    }
+
+    /* back at its wait, the VM is not blocked until the quaint blocks again */
+    if (vm->parked) {
+        unpark(vm);
+    }
+
+    if (insn->wait.any) {
+        /* the handle is the stack pointer from before the quaints were pushed */
+        SAFE_LEGAL_IF(handle < vm->sp && (vm->sp - handle) % 8 == 0,
+            "%" PRIu64 ", %" PRIu64, handle, vm->sp);
+
+        const uint64_t *const list = (const uint64_t *) (vm->stack + handle);
+        count = (uint32_t) ((vm->sp - handle) / 8);
+
+        /* resumed in the middle of the wait, it goes on with the same quaint */
+        current = vm->waiting_any && vm->any_count == count ? vm->any_current : 0;
+        vm->waiting_any = 1;
+        vm->any_count = count;
+
+        for (uint32_t idx = 0; idx < count; ++idx) {
+            const struct qvm *const done = (const struct qvm *) (uintptr_t) list[idx];
+
+#ifdef EXEC_TASKS
+            LEGAL_IF(!done || list[idx] & QVAL_MASK ||
+                !__atomic_load_n(&done->task, __ATOMIC_RELAXED), "spawned quaint in a wait-any");
+#endif
+
+            if (list[idx] & QVAL_MASK || (done && done->at_end)) {
+                return end_wait(vm, idx), vm->ip++, EXEC_OK;
+            }
+        }
+
+        /* null quaints take no turns, and parked ones go last */
+        uint32_t first = count;
+
+        for (uint32_t step = 0; step < count; ++step) {
+            const uint32_t idx = (current + step) % count;
+            const struct qvm *const next = (const struct qvm *) (uintptr_t) list[idx];
+
+            if (next && (first == count || !next->parked)) {
+                first = idx;
+
+                if (!next->parked) {
+                    break;
+                }
+            }
+        }
+
+        if (first == count) {
+            return end_wait(vm, count), vm->ip++, EXEC_OK;
+        }
+
+        current = first;
+        handle = list[current];
+    }
+
+    struct qvm *const qvm = (struct qvm *) (uintptr_t) handle;
+
+#ifdef EXEC_TASKS
+    const bool spawned = qvm && !(handle & QVAL_MASK) &&
+        __atomic_load_n(&qvm->task, __ATOMIC_ACQUIRE);
+#else
+    const bool spawned = false;
+#endif
+
+    if (!qvm || handle & QVAL_MASK || (!spawned && qvm->at_end)) {
+        return vm->ip++, EXEC_OK;
+    }
+
+    /* all blocked in I/O, a noblock wait returns right away */
+    if (!spawned && qvm->parked && insn->wait.noblock) {
+        return end_wait(vm, count), vm->ip++, EXEC_OK;
+    }
+
+    uint64_t tm_val;
+
+    if (insn->wait.has_timeout) {
+        const uint64_t tm_size = opd_size(&insn->wait.timeout);
+        const void *const tm = opd_val(&insn->wait.timeout);
+
+        switch (tm_size) {
+        case 1: tm_val = *( uint8_t *) tm; break;
+        case 2: tm_val = *(uint16_t *) tm; break;
+        case 4: tm_val = *(uint32_t *) tm; break;
+        case 8: tm_val = *(uint64_t *) tm; break;
+        }
+
+        if (!tm_val) {
+            return end_wait(vm, count), vm->ip++, EXEC_OK;
+        }
+
+        tm_val *= insn->wait.units ? (uint64_t) 1000000000 : (uint64_t) 1000000;
+    }
+
+#ifdef EXEC_TASKS
+    /* running elsewhere, a spawned quaint can only be waited for to its end */
+    if (spawned) {
+        LEGAL_IF(labels[insn->wait.label].func <= 1, "wait label of a spawned quaint");
+
+        if (!insn->wait.noblock) {
+            if (insn->wait.has_timeout && unlikely(get_monotonic_time(&now))) {
+                return EXEC_NOMEM;
+            }
+
+            const int error = join_task(qvm, insn->wait.has_timeout ? now + tm_val : 0);
+
+            if (unlikely(error)) {
+                return error;
+            }
+        }
+
+        return vm->ip++, EXEC_OK;
+    }
+#endif
+
+    vm->waiting = 1;
+    vm->waiting_for = vm->waiting_until = 0;
+    vm->waiting_noblock = insn->wait.noblock;
+    vm->any_current = current;
+    vm->any_slice = EXEC_SLICE;
+
+    if (insn->wait.has_timeout) {
+        vm->waiting_for = 1;
+
+        if (unlikely(get_monotonic_time(&now))) {
+            return EXEC_NOMEM;
+        }
+
+        vm->wait_for.start = now;
+        vm->wait_for.interval = tm_val;
+
+        /* an armed deadline that is already due may not have fired yet */
+        if (armed_deadline && armed_deadline <= now) {
+            deadline_passed = 1;
+        }
+
+        if (!armed_deadline || armed_deadline <= now || now + tm_val < armed_deadline) {
+            if (unlikely(arm_deadline(now + tm_val))) {
+                return EXEC_NOMEM;
+            }
+        }
+    } else if (labels[insn->wait.label].func) {
+        vm->waiting_until = 1;
+        vm->wait_until = insn->wait.label;
+    }
+
+    qvm->parent = vm;
+    qvm->may_split = vm->waiting_until || count > 1 || vm->may_split;
+    vm = qvm;
+    return EXEC_OK;
+}
+
+static int insn_wlab(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_WLAB);
+    vm->last_passed = insn->wlab.label;
+    return EXEC_OK;
+}
+
+static int insn_getsp(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_GETSP);
+
+    *((uint64_t *) opd_val(&insn->dst)) = vm->sp;
+    return EXEC_OK;
+}
+
+static int insn_qnt(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_QNT);
+
+    uint64_t *const dst = opd_val(&insn->qnt.dst);
+    const uint64_t loc = *(uint64_t *) opd_val(&insn->qnt.loc);
+    const uint64_t ssp = *(uint64_t *) opd_val(&insn->qnt.sp);
+
+    /* codegen has worked out the stack of the function, if it could */
+    const uint64_t stack_size = loc < o->insn_count && insns[loc].op == CODEGEN_OP_INCSP &&
+        imms[insns[loc].incsp.stack.off] ? 8 * 2 + imms[insns[loc].incsp.stack.off] : 0;
+
+    struct qvm *const qvm = alloc_vm(stack_size);
+
+    if (!qvm) {
+        return EXEC_NOMEM;
+    }
+
+    qvm->ip = loc;
+    qvm->bp = 8 * 2;
+    qvm->sp = qvm->bp + vm->sp - ssp;
+    LEGAL_IF(qvm->sp <= qvm->stack_size, "%" PRIu64, qvm->sp);
+    qvm->at_start = 1;
+    memcpy(qvm->stack + qvm->bp, vm->stack + ssp, (size_t) (vm->sp - ssp));
+    *dst = (uint64_t) (uintptr_t) qvm;
+    vm->sp = ssp;
+#ifdef EXEC_RECLAIM
+    own(vm, qvm, vm->bp);
+#endif
+    return EXEC_OK;
+}
+
+static int insn_qntv(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_QNTV);
+
+    const uint64_t val_size = opd_size(&insn->qntv.val);
+    uint64_t *const dst = opd_val(&insn->qntv.dst);
+    const void *const val = opd_val(&insn->qntv.val);
+
+    if (val_size <= sizeof(uint32_t)) {
+        uint32_t bits = 0;
+        memcpy(&bits, val, (size_t) val_size);
+        *dst = (uint64_t) bits << 32 | QVAL_INLINE;
+        return EXEC_OK;
+    }
+
+    void *const box = heap_alloc(val_size, false);
+
+    if (unlikely(!box)) {
+        return EXEC_NOMEM;
+    }
+
+    memcpy(box, val, (size_t) val_size);
+    *dst = (uint64_t) (uintptr_t) box | QVAL_BOXED;
+    return EXEC_OK;
+}
+
+static int insn_noint_int(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_NOINT || insn->op == CODEGEN_OP_INT);
+    vm->noint = insn->op == CODEGEN_OP_NOINT;
+
+    /* have the next safepoint look again at the deadlines the block held up */
+    if (!vm->noint && deadline_blocked) {
+        deadline_blocked = false;
+        deadline_passed = 1;
+    }
+
+    return EXEC_OK;
+}
+
+/* a listening or a connected local stream socket at the path, -1 on error */
+static int unix_socket(const char *const path, const bool listening)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return errno = ENAMETOOLONG, -1;
+    }
+
+    strcpy(addr.sun_path, path);
+    struct stat st;
+
+    /* a socket left over by an earlier listener would make bind() fail */
+    if (listening && !stat(path, &st) && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    const int failed = listening ?
+        bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, SOMAXCONN) :
+        connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+
+    return failed ? close(fd), -1 : fd;
+}
+
+/*
+ * Workers: workers(n) forks the process into n that share the program and go
+ * on from the call, each with its own index, 0 being the original process.
+ * Every worker has an inbox pipe that all of them can write to. A message is
+ * its u32 size and its bytes in a single write of up to PIPE_BUF bytes, which
+ * never interleaves with another one.
+ */
+#define MSG_SIZE_MAX (PIPE_BUF - sizeof(uint32_t))
+
+static struct {
+    int *inboxes; /* the read and the write end of each */
+    pid_t *pids; /* of the workers forked by this one */
+    uint32_t count, self;
+} workers;
+
+static void stop_workers(void)
+{
+    for (uint32_t idx = 0; idx < 2 * workers.count; ++idx) {
+        if (workers.inboxes[idx] >= 0) {
+            close(workers.inboxes[idx]);
+        }
+    }
+
+    for (uint32_t idx = 0; workers.pids && idx < workers.count; ++idx) {
+        if (workers.pids[idx] > 0) {
+            waitpid(workers.pids[idx], NULL, 0);
+        }
+    }
+
+    free(workers.inboxes);
+    free(workers.pids);
+    workers.inboxes = NULL;
+    workers.pids = NULL;
+    workers.count = workers.self = 0;
+}
+
+/* a forked worker has the timer disarmed and shares the epoll instance */
+static int restart_in_worker(void)
+{
+#ifdef __linux__
+    if (reactor.epfd >= 0) {
+        close(reactor.epfd);
+
+        if ((reactor.epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            return perror("epoll_create1"), EXEC_NOMEM;
+        }
+
+        for (int fd = 0; fd < reactor.size; ++fd) {
+            struct qvm *const parked = reactor.parked[fd];
+
+            if (parked) {
+                reactor.parked[fd] = parked->park_next;
+                parked->parked = 0;
+
+                const int error = park(parked, fd, parked->park_events);
+
+                if (unlikely(error)) {
+                    return error;
+                }
+            }
+        }
+    }
+#endif
+
+    return armed_deadline && arm_deadline(armed_deadline) ? EXEC_NOMEM : EXEC_OK;
+}
+
+/* the index of the worker, or UINT32_MAX on error */
+static uint32_t start_workers(const uint32_t count)
+{
+#ifdef EXEC_TASKS
+    /* only the forking thread would go on in the workers */
+    if (tasks.count) {
+        return UINT32_MAX;
+    }
+#endif
+
+    stop_workers();
+
+    if (!count ||
+        !(workers.inboxes = malloc(2 * count * sizeof(int))) ||
+        !(workers.pids = calloc(count, sizeof(pid_t)))) {
+
+        return stop_workers(), UINT32_MAX;
+    }
+
+    for (workers.count = 0; workers.count < count; ++workers.count) {
+        if (pipe(&workers.inboxes[2 * workers.count])) {
+            return stop_workers(), UINT32_MAX;
+        }
+    }
+
+    /* a message is written whole or not at all, see SCOPE_BFUN_ID_SEND */
+    for (uint32_t idx = 0; idx < count; ++idx) {
+        if (fcntl(workers.inboxes[2 * idx + 1], F_SETFL, O_NONBLOCK)) {
+            return stop_workers(), UINT32_MAX;
+        }
+    }
+
+    /* or else what is still buffered would be printed by every worker */
+    flush_output();
+
+    for (uint32_t idx = 1; idx < count; ++idx) {
+        if ((workers.pids[idx] = fork()) < 0) {
+            return stop_workers(), UINT32_MAX;
+        } else if (workers.pids[idx] == 0) {
+            free(workers.pids);
+            workers.pids = NULL;
+            workers.self = idx;
+            break;
+        }
+    }
+
+    for (uint32_t idx = 0; idx < count; ++idx) {
+        if (idx != workers.self) {
+            close(workers.inboxes[2 * idx]);
+            workers.inboxes[2 * idx] = -1;
+        }
+    }
+
+    if (workers.self && restart_in_worker()) {
+        exit(EXIT_FAILURE);
+    }
+
+    return workers.self;
+}
+
+/*
+ * Checkpoints: save(&q, path) writes a suspended quaint to a file as its
+ * registers and the used part of its stack, and restore(&q, path) reads it
+ * back into a new VM, in this or a later run of the same program. The words
+ * of the stack that point into it or into the globals are stored as offsets.
+ * Any other word that may point into memory of the process, such as a quaint
+ * the saved one has started, makes the quaint unsavable. The image is a
+ * qvm_image, the stack, the temporaries of each call with HEAP_TEMPS (its
+ * size and bytes, the oldest first) and the word indices to relocate.
+ */
+#define IMAGE_AT_START   UINT32_C(1)
+#define IMAGE_NOINT      UINT32_C(2)
+#define IMAGE_HEAP_TEMPS UINT32_C(4)
+#define RELOC_DATA UINT32_C(0x80000000) /* a global, or else a stack offset */
+
+struct qvm_image {
+    char magic[4];
+    uint32_t flags;
+    uint64_t program; /* a fingerprint of the code and the data segment size */
+    uint64_t ip, sp, bp, stack_size, data_size;
+    uint32_t last_passed, waited, frame_count, reloc_count;
+};
+
+static uint64_t fnv1a(uint64_t hash, const void *const mem, const size_t size)
+{
+    for (size_t idx = 0; idx < size; ++idx) {
+        hash = (hash ^ ((const uint8_t *) mem)[idx]) * UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+static uint64_t program_fingerprint(void)
+{
+    const uint64_t sizes[] = {
+        o->insn_count, o->data_size, o->strings.size, imm_count, sizeof(uintptr_t)
+    };
+
+    uint64_t hash = fnv1a(UINT64_C(14695981039346656037), sizes, sizeof(sizes));
+
+    /* the handlers follow from the rest, and the padding is zeroed by encode() */
+    for (size_t ip = 0; ip < o->insn_count; ++ip) {
+        hash = fnv1a(hash, &insns[ip].op, sizeof(insns[ip].op));
+        hash = fnv1a(hash, &insns[ip].bin,
+            sizeof(struct exec_insn) - offsetof(struct exec_insn, bin));
+    }
+
+    hash = fnv1a(hash, imms, imm_count * sizeof(*imms));
+    return fnv1a(hash, o->strings.mem, o->strings.size);
+}
+
+static bool in_heap(const uintptr_t ptr)
+{
+#ifdef EXEC_TASKS
+    return ptr >= __atomic_load_n(&heap_low, __ATOMIC_RELAXED) &&
+        ptr < __atomic_load_n(&heap_high, __ATOMIC_RELAXED);
+#else
+    return ptr >= heap_low && ptr < heap_high;
+#endif
+}
+
+/* the words of data[0, size) at word index `first` on, false if unsavable */
+static bool relocate_words(const struct qvm *const qvm, uint64_t *const data,
+    const uint64_t size, const uint64_t first, uint32_t *const relocs,
+    uint32_t *const reloc_count)
+{
+    const uintptr_t stack = (uintptr_t) qvm->stack, globals = (uintptr_t) bss;
+
+    for (uint64_t idx = 0; idx < size / 8; ++idx) {
+        const uintptr_t ptr = (uintptr_t) data[idx];
+
+        if (ptr >= stack && ptr <= stack + qvm->stack_size) {
+            relocs[(*reloc_count)++] = (uint32_t) (first + idx);
+            data[idx] = ptr - stack;
+        } else if (globals && ptr >= globals && ptr <= globals + bss_size) {
+            relocs[(*reloc_count)++] = (uint32_t) (first + idx) | RELOC_DATA;
+            data[idx] = ptr - globals;
+        } else if (in_heap(ptr)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int32_t save_quaint(const uint64_t handle, const char *const path)
+{
+    const struct qvm *const qvm = (const struct qvm *) (uintptr_t) handle;
+
+    if (!handle || handle & QVAL_MASK || qvm->at_end || qvm->waiting || qvm->parked) {
+        return -2;
+    }
+
+#ifdef EXEC_TASKS
+    if (__atomic_load_n(&qvm->task, __ATOMIC_ACQUIRE)) {
+        return -2;
+    }
+#endif
+
+    for (const struct qvm *running = vm; running; running = running->parent) {
+        if (running == qvm) {
+            return -2;
+        }
+    }
+
+    struct qvm_image image = {
+        .magic = "qvm1",
+        .flags = (qvm->at_start ? IMAGE_AT_START : 0) | (qvm->noint ? IMAGE_NOINT : 0),
+        .program = program_fingerprint(),
+        .ip = qvm->ip,
+        .sp = qvm->sp,
+        .bp = qvm->bp,
+        .stack_size = qvm->stack_size,
+        .data_size = qvm->sp,
+        .last_passed = qvm->last_passed,
+        .waited = qvm->waited,
+    };
+
+#ifdef CODEGEN_HEAP_TEMPS
+    image.flags |= IMAGE_HEAP_TEMPS;
+
+    /* a frame takes up the rest of its chunk up to the next frame */
+    const struct tmp_chunk *chunk = qvm->tmp_chunk;
+    uint64_t end = chunk ? chunk->top : 0;
+
+    for (const struct tmp_frame *frame = qvm->temps; frame; frame = frame->prev) {
+        image.data_size += 8 + end - (uint64_t) (frame->mem - chunk->mem);
+        image.frame_count++;
+        end = frame->top;
+        chunk = frame->chunk;
+    }
+#endif
+
+    if (image.data_size / 8 >= RELOC_DATA) {
+        return -2;
+    }
+
+    uint8_t *const data = malloc((size_t) image.data_size);
+    uint32_t *const relocs = malloc((size_t) image.data_size / 8 * sizeof(uint32_t) + 1);
+    int32_t status = -1;
+    FILE *file = NULL;
+
+    if (unlikely(!data || !relocs)) {
+        goto out;
+    }
+
+    memcpy(data, qvm->stack, (size_t) qvm->sp);
+    memset(data, 0, 16);
+
+    if (!relocate_words(qvm, (uint64_t *) data, qvm->sp, 0, relocs, &image.reloc_count)) {
+        status = -2;
+        goto out;
+    }
+
+#ifdef CODEGEN_HEAP_TEMPS
+    uint64_t offset = image.data_size;
+    chunk = qvm->tmp_chunk;
+    end = chunk ? chunk->top : 0;
+
+    for (const struct tmp_frame *frame = qvm->temps; frame; frame = frame->prev) {
+        const uint64_t size = end - (uint64_t) (frame->mem - chunk->mem);
+        offset -= 8 + size;
+        memcpy(data + offset, &size, 8);
+        memcpy(data + offset + 8, frame->mem, (size_t) size);
+
+        if (!relocate_words(qvm, (uint64_t *) (data + offset + 8), size, offset / 8 + 1,
+            relocs, &image.reloc_count)) {
+
+            status = -2;
+            goto out;
+        }
+
+        end = frame->top;
+        chunk = frame->chunk;
+    }
+#endif
+
+    if ((file = fopen(path, "wb")) &&
+        fwrite(&image, sizeof(image), 1, file) == 1 &&
+        fwrite(data, 1, (size_t) image.data_size, file) == image.data_size &&
+        fwrite(relocs, sizeof(uint32_t), image.reloc_count, file) == image.reloc_count) {
+
+        status = 0;
+    }
+
+out:
+    if (file && fclose(file)) {
+        status = -1;
+    }
+
+    free(data);
+    free(relocs);
+    return status;
+}
+
+/* the whole image, NULL on error */
+static uint8_t *read_image(const char *const path, uint64_t *const size)
+{
+    FILE *const file = fopen(path, "rb");
+    uint8_t *mem = NULL;
+    long end;
+
+    if (file && !fseek(file, 0, SEEK_END) && (end = ftell(file)) >= 0 &&
+        !fseek(file, 0, SEEK_SET) && (mem = malloc((size_t) end + 1)) &&
+        fread(mem, 1, (size_t) end, file) == (size_t) end) {
+
+        *size = (uint64_t) end;
+    } else {
+        free(mem);
+        mem = NULL;
+    }
+
+    if (file) {
+        fclose(file);
+    }
+
+    return mem;
+}
+
+static int32_t restore_quaint(uint64_t *const handle, const char *const path)
+{
+    uint64_t file_size;
+    uint8_t *const file = read_image(path, &file_size);
+    struct qvm_image image;
+    struct qvm *qvm = NULL;
+    int32_t status = -1;
+
+    if (!file) {
+        return -1;
+    }
+
+    if (file_size < sizeof(image)) {
+        goto out;
+    }
+
+    memcpy(&image, file, sizeof(image));
+
+    uint8_t *const data = file + sizeof(image);
+    const uint32_t *const relocs = (const uint32_t *) (data + image.data_size);
+
+    if (memcmp(image.magic, "qvm1", 4) ||
+        image.data_size > file_size - sizeof(image) ||
+        image.data_size % 8 ||
+        (file_size - sizeof(image) - image.data_size) / sizeof(uint32_t) != image.reloc_count ||
+        (file_size - sizeof(image) - image.data_size) % sizeof(uint32_t)) {
+
+        goto out;
+    }
+
+#ifdef CODEGEN_HEAP_TEMPS
+    const uint32_t heap_temps = IMAGE_HEAP_TEMPS;
+#else
+    const uint32_t heap_temps = 0;
+#endif
+
+    if ((image.flags & IMAGE_HEAP_TEMPS) != heap_temps ||
+        image.program != program_fingerprint() ||
+        image.ip >= o->insn_count ||
+        image.sp < 16 || image.sp % 8 || image.sp > image.data_size ||
+        image.bp > image.sp || image.bp % 8) {
+
+        status = -2;
+        goto out;
+    }
+
+    if (unlikely(!(qvm = alloc_vm(image.stack_size)))) {
+        goto out;
+    }
+
+    if (qvm->stack_size < image.sp) {
+        status = -2;
+        goto out;
+    }
+
+    for (uint32_t idx = 0; idx < image.reloc_count; ++idx) {
+        const uint64_t word = relocs[idx] & ~RELOC_DATA;
+        uint64_t off;
+
+        if (word >= image.data_size / 8) {
+            goto out;
+        }
+
+        memcpy(&off, data + 8 * word, 8);
+
+        if (relocs[idx] & RELOC_DATA) {
+            if (off > bss_size) {
+                goto out;
+            }
+
+            off += (uint64_t) (uintptr_t) bss;
+        } else {
+            if (off > qvm->stack_size) {
+                goto out;
+            }
+
+            off += (uint64_t) (uintptr_t) qvm->stack;
+        }
+
+        memcpy(data + 8 * word, &off, 8);
+    }
+
+    memcpy(qvm->stack, data, (size_t) image.sp);
+
+#ifdef CODEGEN_HEAP_TEMPS
+    struct qvm *const running = vm;
+    uint64_t offset = image.sp;
+    vm = qvm;
+
+    for (uint32_t idx = 0; idx < image.frame_count; ++idx) {
+        uint64_t size;
+
+        if (image.data_size - offset < 8 ||
+            (memcpy(&size, data + offset, 8), size % 8) ||
+            size > image.data_size - offset - 8 ||
+            push_temps(size)) {
+
+            vm = running;
+            goto out;
+        }
+
+        memcpy(qvm->temps->mem, data + offset + 8, (size_t) size);
+        offset += 8 + size;
+    }
+
+    vm = running;
+#else
+    if (image.frame_count) {
+        goto out;
+    }
+#endif
+
+    qvm->ip = image.ip;
+    qvm->sp = image.sp;
+    qvm->bp = image.bp;
+    qvm->at_start = !!(image.flags & IMAGE_AT_START);
+    qvm->noint = !!(image.flags & IMAGE_NOINT);
+    qvm->last_passed = image.last_passed;
+    qvm->waited = image.waited;
+    *handle = (uint64_t) (uintptr_t) qvm;
+#ifdef EXEC_RECLAIM
+    own(vm, qvm, vm->bp);
+#endif
+    qvm = NULL;
+    status = 0;
+
+out:
+    if (qvm) {
+        free_vm(qvm);
+    }
+
+    free(file);
+    return status;
+}
+
+static int insn_bfun(const struct exec_insn *const insn)
+{
+    assert(insn->op == CODEGEN_OP_BFUN);
+
+    SAFE_LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
+    SAFE_LEGAL_IF(vm->bp % 8 == 0, "%" PRIu64, vm->bp);
+    SAFE_LEGAL_IF(vm->sp >= 16, "%" PRIu64, vm->sp);
+
+    uint64_t retval_size = 0, mem;
+    int32_t ival;
+    int error;
+    const void *retval = NULL;
+
+    switch (vm->ip) {
+    case SCOPE_BFUN_ID_NULL:
+        LEGAL_IF(0, "null function call");
+        break;
+
+    case SCOPE_BFUN_ID_MONOTIME:
+        if (unlikely(get_monotonic_time(&now))) {
+            return EXEC_NOMEM;
+        }
+
+        retval_size = sizeof(now);
+        retval = &now;
+        break;
+
+    case SCOPE_BFUN_ID_MALLOC:
+    case SCOPE_BFUN_ID_CALLOC: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+        retval_size = 8;
+        const size_t size = (size_t) *(uint64_t *) (vm->stack + vm->bp);
+
+        mem = (uint64_t) (uintptr_t) heap_alloc(size, vm->ip == SCOPE_BFUN_ID_CALLOC);
+        retval = &mem;
+        vm->sp -= 8;
+    } break;
+
+    case SCOPE_BFUN_ID_REALLOC: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+        retval_size = 8;
+        void *const oldptr = (void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
+        const size_t newsize = (size_t) *(uint64_t *) (vm->stack + vm->bp + 8);
+        mem = (uint64_t) (uintptr_t) heap_realloc(oldptr, newsize);
+        retval = &mem;
+        vm->sp -= 16;
+    } break;
+
+    case SCOPE_BFUN_ID_FREE: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+        void *const ptr = (void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
+        heap_free(ptr);
+        vm->sp -= 8;
+    } break;
+
+    case SCOPE_BFUN_ID_PS:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+        put_str((const char *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp));
+        vm->sp -= 8;
+        break;
+
+    case SCOPE_BFUN_ID_PU8:
+    case SCOPE_BFUN_ID_PI8:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 1 <= vm->stack_size, "%" PRIu64, vm->bp);
+
+        vm->ip == SCOPE_BFUN_ID_PU8 ?
+            put_u64(*(uint8_t *) (vm->stack + vm->bp)) :
+            put_i64(*(int8_t *) (vm->stack + vm->bp));
+
+        vm->sp -= 8;
+        break;
+
+    case SCOPE_BFUN_ID_PU16:
+    case SCOPE_BFUN_ID_PI16:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 2 <= vm->stack_size, "%" PRIu64, vm->bp);
+
+        vm->ip == SCOPE_BFUN_ID_PU16 ?
+            put_u64(*(uint16_t *) (vm->stack + vm->bp)) :
+            put_i64(*(int16_t *) (vm->stack + vm->bp));
+
+        vm->sp -= 8;
+        break;
+
+    case SCOPE_BFUN_ID_PU32:
+    case SCOPE_BFUN_ID_PI32:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 4 <= vm->stack_size, "%" PRIu64, vm->bp);
+
+        vm->ip == SCOPE_BFUN_ID_PU32 ?
+            put_u64(*(uint32_t *) (vm->stack + vm->bp)) :
+            put_i64(*(int32_t *) (vm->stack + vm->bp));
+
+        vm->sp -= 8;
+        break;
+
+    case SCOPE_BFUN_ID_PU64:
+    case SCOPE_BFUN_ID_PI64:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+
+        vm->ip == SCOPE_BFUN_ID_PU64 ?
+            put_u64(*(uint64_t *) (vm->stack + vm->bp)) :
+            put_i64(*(int64_t *) (vm->stack + vm->bp));
+
+        vm->sp -= 8;
+        break;
+
+    case SCOPE_BFUN_ID_PNL:
+        put_str("\n");
+        break;
+
+    case SCOPE_BFUN_ID_FLUSH:
+        flush_output();
+        break;
+
+    case SCOPE_BFUN_ID_PF:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+
+        print_format((const char *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp),
+            (const uint8_t *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp + 8));
+
+        vm->sp -= 16;
+        break;
+
+    case SCOPE_BFUN_ID_MEMCPY:
+    case SCOPE_BFUN_ID_MEMSET:
+    case SCOPE_BFUN_ID_MEMCMP:
+    case SCOPE_BFUN_ID_MEMCHR: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 24, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 24 <= vm->stack_size, "%" PRIu64, vm->bp);
+        void *const ptr = (void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
+        const uint64_t arg = *(uint64_t *) (vm->stack + vm->bp + 8);
+        const size_t size = (size_t) *(uint64_t *) (vm->stack + vm->bp + 16);
+
+        /* memcpy() copies overlapping buffers as memmove() does */
+        switch (vm->ip) {
+        case SCOPE_BFUN_ID_MEMCPY:
+            mem = (uint64_t) (uintptr_t) memmove(ptr, (const void *) (uintptr_t) arg, size);
+            break;
+
+        case SCOPE_BFUN_ID_MEMSET:
+            mem = (uint64_t) (uintptr_t) memset(ptr, *(uint8_t *) (vm->stack + vm->bp + 8), size);
+            break;
+
+        case SCOPE_BFUN_ID_MEMCMP:
+            ival = memcmp(ptr, (const void *) (uintptr_t) arg, size);
+            ival = (ival > 0) - (ival < 0);
+            break;
+
+        case SCOPE_BFUN_ID_MEMCHR:
+            mem = (uint64_t) (uintptr_t) memchr(ptr, *(uint8_t *) (vm->stack + vm->bp + 8), size);
+            break;
+        }
+
+        retval_size = vm->ip == SCOPE_BFUN_ID_MEMCMP ? 4 : 8;
+        retval = vm->ip == SCOPE_BFUN_ID_MEMCMP ? (const void *) &ival : &mem;
+        vm->sp -= 24;
+    } break;
+
+    case SCOPE_BFUN_ID_STRLEN:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+        mem = (uint64_t) strlen((const char *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp));
+        retval_size = 8;
+        retval = &mem;
+        vm->sp -= 8;
+        break;
+
+    case SCOPE_BFUN_ID_OPEN: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+        const char *const path = (const char *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
+        const uint32_t mode = *(uint32_t *) (vm->stack + vm->bp + 8);
+
+        /* 0 reads, 1 writes over and 2 appends, creating the file if need be */
+        static const int flags[] = {
+            O_RDONLY, O_WRONLY | O_CREAT | O_TRUNC, O_WRONLY | O_CREAT | O_APPEND,
+        };
+
+        ival = mode < countof(flags) ? open(path, flags[mode] | O_CLOEXEC, 0666) : -1;
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 16;
+    } break;
+
+    case SCOPE_BFUN_ID_MMAP: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+        const int fd = *(int32_t *) (vm->stack + vm->bp);
+        uint64_t *const size = (uint64_t *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp + 8);
+        struct stat st;
+        mem = 0;
+
+        if (size) {
+            *size = 0;
+        }
+
+        /* an empty file cannot be mapped, NULL and a size of 0 do the same */
+        if (!fstat(fd, &st) && st.st_size > 0 && (uint64_t) st.st_size <= SIZE_MAX) {
+            void *const mapped = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (mapped != MAP_FAILED) {
+                posix_madvise(mapped, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);
+                note_heap(mapped, (uint64_t) st.st_size);
+                mem = (uint64_t) (uintptr_t) mapped;
+
+                if (size) {
+                    *size = (uint64_t) st.st_size;
+                }
+            }
+        }
+
+        retval_size = 8;
+        retval = &mem;
+        vm->sp -= 16;
+    } break;
+
+    case SCOPE_BFUN_ID_MUNMAP:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+
+        ival = munmap((void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp),
+            (size_t) *(uint64_t *) (vm->stack + vm->bp + 8));
+
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 16;
+        break;
+
+    case SCOPE_BFUN_ID_BWRITE:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 24, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 24 <= vm->stack_size, "%" PRIu64, vm->bp);
 
-static int insn_cjmp(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_JZ || insn->op == CODEGEN_OP_JNZ);
+        mem = (uint64_t) buffered_write(*(int32_t *) (vm->stack + vm->bp),
+            (const void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp + 8),
+            (size_t) *(uint64_t *) (vm->stack + vm->bp + 16));
 
-    const uint8_t cond_signd = insn->jmp.cond.signd;
-    const uint64_t cond_size = opd_size(&insn->jmp.cond);
+        retval_size = 8;
+        retval = &mem;
+        vm->sp -= 24;
+        break;
 
-    LEGAL_IF(cond_signd == 0 || cond_signd == 1, "%u", cond_signd);
-    LEGAL_IF(cond_size > 0, "0");
+    case SCOPE_BFUN_ID_ARENA: {
+        struct arena *const arena = heap_alloc(sizeof(struct arena), true);
+        mem = (uint64_t) (uintptr_t) arena;
+        retval_size = 8;
+        retval = &mem;
+    } break;
 
-    const void *const cond = opd_val(&insn->jmp.cond);
-    static const uint8_t zero_mem[128];
-    int all_zero;
+    case SCOPE_BFUN_ID_AALLOC: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+        struct arena *const arena = (struct arena *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
+        const uint64_t size = *(uint64_t *) (vm->stack + vm->bp + 8);
+        mem = arena ? (uint64_t) (uintptr_t) arena_alloc(arena, size) : 0;
+        retval_size = 8;
+        retval = &mem;
+        vm->sp -= 16;
+    } break;
 
-    if (unlikely(cond_size > 128)) {
-        void *const zero_alloc = calloc(1, (size_t) cond_size);
+    case SCOPE_BFUN_ID_ARESET:
+    case SCOPE_BFUN_ID_AFREE: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+        struct arena *const arena = (struct arena *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
 
-        if (unlikely(!zero_alloc)) {
-            return EXEC_NOMEM;
+        if (arena) {
+            (vm->ip == SCOPE_BFUN_ID_ARESET ? arena_reset : arena_free)(arena);
         }
 
-        all_zero = !memcmp(zero_alloc, cond, (size_t) cond_size);
-        free(zero_alloc);
-    } else {
-        all_zero = !memcmp(zero_mem, cond, (size_t) cond_size);
-    }
+        vm->sp -= 8;
+    } break;
 
-    if (insn->op == CODEGEN_OP_JZ) {
-        if (all_zero) {
-            vm->ip = insn->jmp.loc;
-        } else {
-            vm->ip++;
+    case SCOPE_BFUN_ID_EXIT:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 4 <= vm->stack_size, "%" PRIu64, vm->bp);
+        vm->sp -= 8;
+        flush_output();
+        exit(*(int32_t *) (vm->stack + vm->bp));
+        break;
+
+    case SCOPE_BFUN_ID_WAITED:
+        retval_size = sizeof(vm->waited);
+        retval = &vm->waited;
+        break;
+
+    case SCOPE_BFUN_ID_READ:
+    case SCOPE_BFUN_ID_WRITE: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 24, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 24 <= vm->stack_size, "%" PRIu64, vm->bp);
+        const int fd = *(int32_t *) (vm->stack + vm->bp);
+        void *const buf = (void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp + 8);
+        const size_t size = (size_t) *(uint64_t *) (vm->stack + vm->bp + 16);
+        bool ready;
+
+        if (vm->ip == SCOPE_BFUN_ID_WRITE) {
+            fd == STDOUT_FILENO ? flush_output() : drop_fd_buffer(fd);
         }
-    } else {
-        if (all_zero) {
-            vm->ip++;
-        } else {
-            vm->ip = insn->jmp.loc;
+
+        if (unlikely(error = io_ready(fd, vm->ip == SCOPE_BFUN_ID_READ ? POLLIN : POLLOUT, &ready)) || !ready) {
+            return error;
         }
-    }
 
-    return EXEC_OK;
-}
+        mem = (uint64_t) (vm->ip == SCOPE_BFUN_ID_READ ? read(fd, buf, size) : write(fd, buf, size));
+        retval_size = 8;
+        retval = &mem;
+        vm->sp -= 24;
+    } break;
 
-static int insn_jmp(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_JMP);
-    vm->ip = insn->jmp.loc;
-    return EXEC_OK;
-}
+    case SCOPE_BFUN_ID_ACCEPT: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 4 <= vm->stack_size, "%" PRIu64, vm->bp);
+        const int fd = *(int32_t *) (vm->stack + vm->bp);
+        bool ready;
 
-static int insn_pushr(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_PUSHR);
+        if (unlikely(error = io_ready(fd, POLLIN, &ready)) || !ready) {
+            return error;
+        }
 
-    const uint8_t retip_is_imm = insn->push.val.opd == CODEGEN_OPD_IMM;
-    const uint8_t retip_signd = insn->push.val.signd;
-    const uint8_t retip_indirect = insn->push.val.indirect;
-    const uint64_t retip_size = opd_size(&insn->push.val);
+        ival = accept(fd, NULL, NULL);
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 8;
+    } break;
 
-    LEGAL_IF(retip_is_imm == 1, "%u", retip_is_imm);
-    LEGAL_IF(retip_signd == 0, "%u", retip_signd);
-    LEGAL_IF(retip_indirect == 0, "%u", retip_indirect);
-    LEGAL_IF(retip_size == 8, "%" PRIu64, retip_size);
+    case SCOPE_BFUN_ID_CLOSE:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 4 <= vm->stack_size, "%" PRIu64, vm->bp);
+        drop_fd_buffer(*(int32_t *) (vm->stack + vm->bp));
+        ival = close(*(int32_t *) (vm->stack + vm->bp));
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 8;
+        break;
 
-    const uint8_t ssp_is_temp = insn->push.ssp.opd == CODEGEN_OPD_TEMP;
-    const uint8_t ssp_signd = insn->push.ssp.signd;
-    const uint8_t ssp_indirect = insn->push.ssp.indirect;
-    const uint64_t ssp_size = opd_size(&insn->push.ssp);
+    case SCOPE_BFUN_ID_PIPE:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+        ival = pipe((int *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp));
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 8;
+        break;
 
-    LEGAL_IF(ssp_is_temp == 1, "%u", ssp_is_temp);
-    LEGAL_IF(ssp_signd == 0, "%u", ssp_signd);
-    LEGAL_IF(ssp_indirect == 0, "%u", ssp_indirect);
-    LEGAL_IF(ssp_size == 8, "%" PRIu64, ssp_size);
+    case SCOPE_BFUN_ID_LISTEN:
+    case SCOPE_BFUN_ID_CONNECT:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 8 <= vm->stack_size, "%" PRIu64, vm->bp);
+        ival = unix_socket((const char *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp),
+            vm->ip == SCOPE_BFUN_ID_LISTEN);
 
-    LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
-    LEGAL_IF(vm->sp + 16 <= STACK_SIZE, "%" PRIu64, vm->sp);
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 8;
+        break;
 
-    const uint64_t retip = insn->push.val.imm;
-    uint64_t *const ssp = opd_val(&insn->push.ssp);
+    case SCOPE_BFUN_ID_NCPUS: {
+        const long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        ival = ncpus > 0 ? (int32_t) ncpus : 1;
+        retval_size = 4;
+        retval = &ival;
+    } break;
 
-    *(uint64_t *) (vm->stack + vm->sp) = retip;
-    *(uint64_t *) (vm->stack + vm->sp + 8) = (uint64_t) vm->bp;
+    case SCOPE_BFUN_ID_WORKERS:
+        SAFE_LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 4 <= vm->stack_size, "%" PRIu64, vm->bp);
+        ival = (int32_t) start_workers(*(uint32_t *) (vm->stack + vm->bp));
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 8;
+        break;
 
-    vm->sp += 16;
-    *ssp = vm->sp;
+    case SCOPE_BFUN_ID_SEND: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 24, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 24 <= vm->stack_size, "%" PRIu64, vm->bp);
+        const uint32_t to = *(uint32_t *) (vm->stack + vm->bp);
+        const void *const msg = (const void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp + 8);
+        const uint64_t size = *(uint64_t *) (vm->stack + vm->bp + 16);
+        ival = -1;
+
+        if (to < workers.count && size <= MSG_SIZE_MAX) {
+            const int fd = workers.inboxes[2 * to + 1];
+            uint8_t frame[PIPE_BUF];
+            bool ready;
+
+            if (unlikely(error = io_ready(fd, POLLOUT, &ready)) || !ready) {
+                return error;
+            }
 
-    return EXEC_OK;
-}
+            *(uint32_t *) frame = (uint32_t) size;
+            memcpy(frame + sizeof(uint32_t), msg, (size_t) size);
 
-static int insn_push(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_PUSH);
+            const ssize_t written = write(fd, frame, sizeof(uint32_t) + (size_t) size);
 
-    const uint8_t val_signd = insn->push.val.signd;
-    const uint8_t val_indirect = insn->push.val.indirect;
-    const uint64_t val_size = opd_size(&insn->push.val);
+            /* another worker may have filled the inbox since the poll */
+            if (written < 0 && errno == EAGAIN) {
+                return park_on(fd, POLLOUT);
+            }
 
-    LEGAL_IF(val_signd == 0 || val_signd == 1, "%u", val_signd);
-    LEGAL_IF(val_indirect == 0 || val_indirect == 1, "%u", val_indirect);
-    LEGAL_IF(val_size > 0, "%" PRIu64, val_size);
+            if (written == (ssize_t) (sizeof(uint32_t) + size)) {
+                ival = 0;
+            }
+        }
 
-    LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
-    LEGAL_IF(vm->sp + val_size <= STACK_SIZE, "%" PRIu64 ", %" PRIu64, vm->sp, val_size);
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 24;
+    } break;
 
-    const void *const val = opd_val(&insn->push.val);
-    memcpy(vm->stack + vm->sp, val, (size_t) val_size);
-    vm->sp += val_size;
-    ALIGN_UP(vm->sp, 8);
-    LEGAL_IF(vm->sp <= STACK_SIZE, "%" PRIu64, vm->sp);
+    case SCOPE_BFUN_ID_RECV: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+        uint8_t *const buf = (uint8_t *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
+        const size_t size = (size_t) *(uint64_t *) (vm->stack + vm->bp + 8);
+        mem = (uint64_t) -1;
+
+        if (workers.count) {
+            const int fd = workers.inboxes[2 * workers.self];
+            uint8_t frame[PIPE_BUF];
+            uint32_t msg_size;
+            bool ready;
+
+            if (unlikely(error = io_ready(fd, POLLIN, &ready)) || !ready) {
+                return error;
+            }
 
-    return EXEC_OK;
-}
+            /* the whole message is in the pipe once its size is */
+            if (read(fd, &msg_size, sizeof(msg_size)) == sizeof(msg_size) &&
+                read(fd, frame, msg_size) == (ssize_t) msg_size) {
 
-static int insn_call_callv(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_CALL || insn->op == CODEGEN_OP_CALLV);
+                memcpy(buf, frame, msg_size < size ? msg_size : size);
+                mem = msg_size;
+            }
+        }
 
-    const uint8_t loc_signd = insn->call.loc.signd;
-    const uint8_t loc_indirect = insn->call.loc.indirect;
-    const uint64_t loc_size = opd_size(&insn->call.loc);
+        retval_size = 8;
+        retval = &mem;
+        vm->sp -= 16;
+    } break;
 
-    LEGAL_IF(loc_signd == 0, "%u", loc_signd);
-    LEGAL_IF(loc_indirect == 0 || loc_indirect == 1, "%u", loc_indirect);
-    LEGAL_IF(loc_size == 8, "%" PRIu64, loc_size);
+    case SCOPE_BFUN_ID_SAVE:
+    case SCOPE_BFUN_ID_RESTORE: {
+        SAFE_LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
+        SAFE_LEGAL_IF(vm->bp + 16 <= vm->stack_size, "%" PRIu64, vm->bp);
+        uint64_t *const handle = (uint64_t *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
+        const char *const path = (const char *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp + 8);
+        LEGAL_IF(handle != NULL, "null quaint pointer");
 
-    const uint8_t bp_is_temp = insn->call.bp.opd == CODEGEN_OPD_TEMP;
-    const uint8_t bp_signd = insn->call.bp.signd;
-    const uint8_t bp_indirect = insn->call.bp.indirect;
-    const uint64_t bp_size = opd_size(&insn->call.bp);
+        ival = vm->ip == SCOPE_BFUN_ID_SAVE ?
+            save_quaint(*handle, path) : restore_quaint(handle, path);
 
-    LEGAL_IF(bp_is_temp == 1, "%u", bp_is_temp);
-    LEGAL_IF(bp_signd == 0, "%u", bp_signd);
-    LEGAL_IF(bp_indirect == 0, "%u", bp_indirect);
-    LEGAL_IF(bp_size == 8, "%" PRIu64, bp_size);
+        retval_size = 4;
+        retval = &ival;
+        vm->sp -= 16;
+    } break;
+    }
 
-    const uint64_t *const loc = opd_val(&insn->call.loc);
-    const uint64_t *const bp = opd_val(&insn->call.bp);
+    vm->sp -= 16;
 
-    vm->ip = *loc;
-    vm->bp = *bp;
+#ifdef CODEGEN_HEAP_TEMPS
+    if (unlikely((error = push_temps(0)))) {
+        return error;
+    }
+#endif
 
-    return EXEC_OK;
+    return handle_return(insn, retval_size, retval);
 }
 
-static int insn_incsp(const struct codegen_insn *const insn)
+static int encode_opd(const uint64_t ip, struct exec_opd *const dst,
+    const struct codegen_opd *const src)
 {
-    assert(insn->op == CODEGEN_OP_INCSP);
-
-    const uint8_t addend_is_imm = insn->incsp.addend.opd == CODEGEN_OPD_IMM;
-    const uint8_t addend_signd = insn->incsp.addend.signd;
-    const uint8_t addend_indirect = insn->incsp.addend.indirect;
-    const uint64_t addend_size = opd_size(&insn->incsp.addend);
+    dst->opd = src->opd;
+    dst->signd = src->signd;
+    dst->indirect = src->indirect;
+
+    if (src->opd == CODEGEN_OPD_IMM) {
+        LEGAL_AT(ip, src->immsize <= EXEC_OPD_SIZE_MAX, "%" PRIu64, src->immsize);
+        dst->off = imm_count;
+        dst->size = src->immsize;
+        imms[imm_count++] = src->imm;
+    } else {
+        LEGAL_AT(ip, src->off <= UINT32_MAX, "%" PRIu64, src->off);
+        LEGAL_AT(ip, src->size <= EXEC_OPD_SIZE_MAX, "%" PRIu64, src->size);
+        dst->off = src->off;
+        dst->size = src->size;
+    }
 
-    LEGAL_IF(addend_is_imm == 1, "%u", addend_is_imm);
-    LEGAL_IF(addend_signd == 0, "%u", addend_signd);
-    LEGAL_IF(addend_indirect == 0, "%u", addend_indirect);
-    LEGAL_IF(addend_size == 8, "%" PRIu64, addend_size);
+    return EXEC_OK;
+}
 
-    const uint8_t tsize_is_imm = insn->incsp.tsize.opd == CODEGEN_OPD_IMM;
-    const uint8_t tsize_signd = insn->incsp.tsize.signd;
-    const uint8_t tsize_indirect = insn->incsp.tsize.indirect;
-    const uint64_t tsize_size = opd_size(&insn->incsp.tsize);
+static uint32_t encode_label(const uintptr_t func, const uint64_t id)
+{
+    uint32_t idx;
 
-    LEGAL_IF(tsize_is_imm == 1, "%u", tsize_is_imm);
-    LEGAL_IF(tsize_signd == 0, "%u", tsize_signd);
-    LEGAL_IF(tsize_indirect == 0, "%u", tsize_indirect);
-    LEGAL_IF(tsize_size == 8, "%" PRIu64, tsize_size);
+    for (idx = 0; idx < label_count; ++idx) {
+        if (labels[idx].func == func && labels[idx].id == id) {
+            return idx;
+        }
+    }
 
-    const uint64_t addend = insn->incsp.addend.imm;
-    const uint64_t tsize = insn->incsp.tsize.imm;
+    labels[label_count].func = func;
+    labels[label_count].id = id;
+    return label_count++;
+}
 
-    LEGAL_IF(addend % 8 == 0, "%" PRIu64, addend);
+#define OPD(field) \
+    if (unlikely((error = encode_opd(ip, &insn->field, &wide->field)))) { \
+        return error; \
+    }
 
-    vm->at_start = 0;
-    vm->sp += addend;
-    LEGAL_IF(vm->sp <= STACK_SIZE, "%" PRIu64, vm->sp);
-    LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
+static int encode_insn(const uint64_t ip, struct exec_insn *const insn,
+    const struct codegen_insn *const wide)
+{
+    int error;
+    insn->op = wide->op;
 
-    struct tmp_frame *const new_tmp_frame =
-        malloc(sizeof(struct tmp_frame) + (size_t) tsize);
+    switch (wide->op) {
+    case CODEGEN_OP_MOV:
+    case CODEGEN_OP_CAST:
+    case CODEGEN_OP_NOT:
+    case CODEGEN_OP_NEG:
+    case CODEGEN_OP_BNEG:
+    case CODEGEN_OP_OZ:
+    case CODEGEN_OP_INCP:
+    case CODEGEN_OP_DECP:
+    case CODEGEN_OP_REF:
+    case CODEGEN_OP_DRF:
+    case CODEGEN_OP_RTEV:
+        OPD(un.dst);
+        OPD(un.src);
+        break;
 
-    if (unlikely(!new_tmp_frame)) {
-        return EXEC_NOMEM;
-    }
+    case CODEGEN_OP_RTE:
+        OPD(un.src);
+        break;
 
-    new_tmp_frame->prev = vm->temps;
-    vm->temps = new_tmp_frame;
-    return EXEC_OK;
-}
+    case CODEGEN_OP_ADD:
+    case CODEGEN_OP_SUB:
+    case CODEGEN_OP_MUL:
+    case CODEGEN_OP_DIV:
+    case CODEGEN_OP_MOD:
+    case CODEGEN_OP_EQU:
+    case CODEGEN_OP_NEQ:
+    case CODEGEN_OP_LT:
+    case CODEGEN_OP_GT:
+    case CODEGEN_OP_LTE:
+    case CODEGEN_OP_GTE:
+    case CODEGEN_OP_LSH:
+    case CODEGEN_OP_RSH:
+    case CODEGEN_OP_AND:
+    case CODEGEN_OP_XOR:
+    case CODEGEN_OP_OR:
+        OPD(bin.dst);
+        OPD(bin.src1);
+        OPD(bin.src2);
+        break;
 
-static int insn_ret_retv(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_RET || insn->op == CODEGEN_OP_RETV);
+    case CODEGEN_OP_INC:
+    case CODEGEN_OP_DEC:
+    case CODEGEN_OP_GETSP:
+        OPD(dst);
+        break;
 
-    LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
-    LEGAL_IF(vm->bp % 8 == 0, "%" PRIu64, vm->bp);
+    case CODEGEN_OP_JZ:
+    case CODEGEN_OP_JNZ:
+        OPD(jmp.cond);
+        /* fallthrough */
 
-    const uint8_t size_is_imm = insn->ret.size.opd == CODEGEN_OPD_IMM;
-    const uint8_t size_signd = insn->ret.size.signd;
-    const uint8_t size_indirect = insn->ret.size.indirect;
-    const uint64_t size_size = opd_size(&insn->ret.size);
+    case CODEGEN_OP_JMP:
+        LEGAL_AT(ip, wide->jmp.loc < o->insn_count, "%" PRIu64, wide->jmp.loc);
+        insn->jmp.loc = wide->jmp.loc;
+        break;
 
-    LEGAL_IF(size_is_imm == 1, "%u", size_is_imm);
-    LEGAL_IF(size_signd == 0, "%u", size_signd);
-    LEGAL_IF(size_indirect == 0, "%u", size_indirect);
-    LEGAL_IF(size_size == 8, "%" PRIu64, size_size);
+    case CODEGEN_OP_PUSHR:
+        OPD(push.val);
+        OPD(push.ssp);
+        break;
 
-    const uint64_t size = insn->ret.size.imm;
+    case CODEGEN_OP_PUSH:
+        OPD(push.val);
+        break;
 
-    LEGAL_IF(vm->sp >= size, "%" PRIu64 ", %" PRIu64, vm->sp, size);
-    LEGAL_IF(vm->temps != NULL, "");
-    vm->sp -= size;
+    case CODEGEN_OP_CALLV:
+        OPD(call.val);
+        /* fallthrough */
 
-    const bool with_value = insn->op == CODEGEN_OP_RETV;
-    const uint64_t retval_size = with_value ? opd_size(&insn->ret.val) : 0;
-    const void *const retval = with_value ? opd_val(&insn->ret.val) : NULL;
+    case CODEGEN_OP_CALL:
+        OPD(call.loc);
+        OPD(call.bp);
+        break;
 
-    return handle_return(insn, retval_size, retval);
-}
+    case CODEGEN_OP_INCSP:
+        OPD(incsp.addend);
+        OPD(incsp.tsize);
+        OPD(incsp.stack);
+        break;
 
-static int insn_ref(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_REF);
+    case CODEGEN_OP_RETV:
+        OPD(ret.val);
+        /* fallthrough */
 
-    const uint8_t dst_signd = insn->un.dst.signd;
-    const uint8_t dst_indirect = insn->un.dst.indirect;
-    const uint64_t dst_size = opd_size(&insn->un.dst);
+    case CODEGEN_OP_RET:
+        OPD(ret.size);
+        break;
 
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_indirect == 0, "%u", dst_indirect);
-    LEGAL_IF(dst_size == 8, "%" PRIu64, dst_size);
+    case CODEGEN_OP_QAT:
+        OPD(qat.dst);
+        OPD(qat.quaint);
+        insn->qat.label = encode_label(wide->qat.func, wide->qat.wlab_id);
+        break;
 
-    uint64_t *const dst = opd_val(&insn->un.dst);
-    *dst = (uint64_t) (uintptr_t) opd_val(&insn->un.src);
-    return EXEC_OK;
-}
+    case CODEGEN_OP_WAIT:
+        OPD(wait.quaint);
 
-static int insn_drf(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_DRF);
+        if (wide->wait.has_timeout) {
+            OPD(wait.timeout);
+        }
 
-    const uint8_t dst_signd = insn->un.dst.signd;
-    const uint8_t dst_indirect = insn->un.dst.indirect;
-    const uint64_t dst_size = opd_size(&insn->un.dst);
+        insn->wait.label = encode_label(wide->wait.func, wide->wait.wlab_id);
+        insn->wait.noblock = wide->wait.noblock;
+        insn->wait.units = wide->wait.units;
+        insn->wait.has_timeout = wide->wait.has_timeout;
+        insn->wait.any = wide->wait.any;
+        insn->wait.spawn = wide->wait.spawn;
+        break;
 
-    LEGAL_IF(dst_signd == 0 || dst_signd == 1, "%u", dst_signd);
-    LEGAL_IF(dst_indirect == 0, "%u", dst_indirect);
-    LEGAL_IF(dst_size > 0, "0");
+    case CODEGEN_OP_WLAB:
+        insn->wlab.label = encode_label(wide->wlab.func, wide->wlab.id);
+        break;
 
-    const uint64_t src_size = opd_size(&insn->un.src);
+    case CODEGEN_OP_QNT:
+        OPD(qnt.dst);
+        OPD(qnt.loc);
+        OPD(qnt.sp);
+        break;
 
-    LEGAL_IF(src_size == 8, "%" PRIu64, src_size);
+    case CODEGEN_OP_QNTV:
+        OPD(qntv.dst);
+        OPD(qntv.val);
+        break;
 
-    void *const dst = opd_val(&insn->un.dst);
-    const uint64_t *const src = opd_val(&insn->un.src);
+    /* the rest have no operands, unknown instructions are left to verify() */
+    default: break;
+    }
 
-    memcpy(dst, (const void *) (uintptr_t) *src, (size_t) dst_size);
     return EXEC_OK;
 }
 
-static int insn_rte_rtev(const struct codegen_insn *const insn)
+#undef OPD
+
+/*
+ * Converts the program into the dense form it is executed in. The wide form
+ * of codegen is kept as it is, for printing and debugging.
+ */
+static int encode(void)
 {
-    assert(insn->op == CODEGEN_OP_RTE || insn->op == CODEGEN_OP_RTEV);
-    const bool with_value = insn->op == CODEGEN_OP_RTEV;
+    const size_t count = o->insn_count;
 
-    uint8_t dst_signd;
-    uint8_t dst_indirect;
-    uint64_t dst_size;
-    void *dst;
+    insns = calloc(count + 1, sizeof(*insns));
+    imms = malloc((3 * count + 1) * sizeof(*imms));
+    labels = malloc((count + 1) * sizeof(*labels));
+    imm_count = label_count = 0;
 
-    if (with_value) {
-        dst_signd = insn->un.dst.signd;
-        dst_indirect = insn->un.dst.indirect;
-        dst_size = opd_size(&insn->un.dst);
+    if (unlikely(!insns || !imms || !labels)) {
+        return EXEC_NOMEM;
+    }
 
-        LEGAL_IF(dst_signd == 0 || dst_signd == 1, "%u", dst_signd);
-        LEGAL_IF(dst_indirect == 0, "%u", dst_indirect);
-        LEGAL_IF(dst_size > 0, "%" PRIu64, dst_size);
+    encode_label(0, 0);
 
-        dst = opd_val(&insn->un.dst);
+    for (uint64_t ip = 0; ip < count; ++ip) {
+        const int error = encode_insn(ip, &insns[ip], &o->insns[ip]);
+
+        if (unlikely(error)) {
+            return error;
+        }
     }
 
-    const uint8_t qnt_signd = insn->un.src.signd;
-    const uint8_t qnt_indirect = insn->un.src.indirect;
-    const uint64_t qnt_size = opd_size(&insn->un.src);
+    uint64_t *const shrunk = realloc(imms, (imm_count + 1) * sizeof(*imms));
 
-    LEGAL_IF(qnt_signd == 0, "%u", qnt_signd);
-    LEGAL_IF(qnt_indirect == 0 || qnt_indirect == 1, "%u", qnt_indirect);
-    LEGAL_IF(qnt_size == 8, "%" PRIu64, qnt_size);
+    if (shrunk) {
+        imms = shrunk;
+    }
 
-    struct qvm *const qvm = (struct qvm *) (uintptr_t)
-        *(uint64_t *) opd_val(&insn->un.src);
+    return EXEC_OK;
+}
 
-    if (!qvm) {
-        if (with_value) {
-            memset(dst, 0, (size_t) dst_size);
-        }
+static int verify_opd(const uint64_t ip, const struct exec_opd *const operand)
+{
+    switch (operand->opd) {
+    case CODEGEN_OPD_IMM:
+        LEGAL_AT(ip, operand->signd == 0, "%u", operand->signd);
+        LEGAL_AT(ip, operand->indirect == 0, "%u", operand->indirect);
+        LEGAL_AT(ip, powerof2((uint32_t) operand->size) && operand->size <= 8,
+            "%u", operand->size);
+        break;
 
-        return vm->ip++, EXEC_OK;
-    }
+#ifdef CODEGEN_HEAP_TEMPS
+    case CODEGEN_OPD_TEMP:
+        LEGAL_AT(ip, operand->size > 0, "0");
+        break;
+#else
+    case CODEGEN_OPD_TEMP:
+#endif
 
-    if (qvm->at_end) {
-        if (with_value) {
-            memcpy(dst, qvm->stack, (size_t) dst_size);
-        }
+    case CODEGEN_OPD_AUTO:
+        LEGAL_AT(ip, operand->size > 0, "0");
+        LEGAL_AT(ip, operand->off < STACK_SIZE, "%" PRIu32, operand->off);
+        break;
 
-        free(qvm);
-        *(uint64_t *) opd_val(&insn->un.src) = 0;
-        return vm->ip++, EXEC_OK;
+    case CODEGEN_OPD_GLOB:
+        LEGAL_AT(ip, operand->size > 0, "0");
+        LEGAL_AT(ip, (uint64_t) operand->off + (operand->indirect ? 8 : operand->size) <= bss_size,
+            "%" PRIu32 ", %u", operand->off, operand->size);
+        break;
+
+    default: LEGAL_AT(ip, false, "unknown operand: %u", operand->opd);
     }
 
-    qvm->parent = vm;
-    vm = qvm;
     return EXEC_OK;
 }
 
-static int insn_qat(const struct codegen_insn *const insn)
+/* an operand of a scalar type: 1, 2, 4 or 8 bytes */
+static int verify_scalar(const uint64_t ip, const struct exec_opd *const operand)
 {
-    assert(insn->op == CODEGEN_OP_QAT);
+    const int error = verify_opd(ip, operand);
 
-    const uint8_t dst_signd = insn->qat.dst.signd;
-    const uint8_t dst_indirect = insn->qat.dst.indirect;
-    const uint64_t dst_size = opd_size(&insn->qat.dst);
+    if (unlikely(error)) {
+        return error;
+    }
 
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_indirect == 0, "%u", dst_indirect);
-    LEGAL_IF(dst_size == 1, "%" PRIu64, dst_size);
+    const uint64_t size = opd_size(operand);
+    LEGAL_AT(ip, powerof2(size) && size <= 8, "%" PRIu64, size);
+    return EXEC_OK;
+}
 
-    const uint8_t qnt_signd = insn->qat.quaint.signd;
-    const uint8_t qnt_indirect = insn->qat.quaint.indirect;
-    const uint64_t qnt_size = opd_size(&insn->qat.quaint);
+/* an operand holding an unsigned 64-bit word: a pointer, a location or a size */
+static int verify_word(const uint64_t ip, const struct exec_opd *const operand,
+    const int opd)
+{
+    const int error = verify_opd(ip, operand);
 
-    LEGAL_IF(qnt_signd == 0, "%u", qnt_signd);
-    LEGAL_IF(qnt_indirect == 0 || qnt_indirect == 1, "%u", qnt_indirect);
-    LEGAL_IF(qnt_size == 8, "%" PRIu64, qnt_size);
+    if (unlikely(error)) {
+        return error;
+    }
 
-    uint8_t *const dst = opd_val(&insn->qat.dst);
-    struct qvm *const qvm = (struct qvm *) (uintptr_t)
-        *(uint64_t *) opd_val(&insn->qat.quaint);
+    LEGAL_AT(ip, opd < 0 || operand->opd == opd, "%u", operand->opd);
+    LEGAL_AT(ip, operand->signd == 0, "%u", operand->signd);
+    LEGAL_AT(ip, opd_size(operand) == 8, "%" PRIu64, opd_size(operand));
+    return EXEC_OK;
+}
 
-    if (!qvm) {
-        *dst = 0;
-    } else if (!insn->qat.func && !insn->qat.wlab_id) {
-        *dst = qvm->at_start;
-    } else if (insn->qat.func == 1) {
-        *dst = qvm->at_end;
-    } else {
-        *dst = qvm->last_passed.func == insn->qat.func &&
-            qvm->last_passed.id == insn->qat.wlab_id;
+/* an immediate location must point into the code */
+static int verify_loc(const uint64_t ip, const struct exec_opd *const operand)
+{
+    const int error = verify_word(ip, operand, -1);
+
+    if (unlikely(error)) {
+        return error;
     }
 
+    LEGAL_AT(ip, operand->opd != CODEGEN_OPD_IMM || imms[operand->off] < o->insn_count,
+        "%" PRIu64, imms[operand->off]);
+
     return EXEC_OK;
 }
 
-static int insn_wait(const struct codegen_insn *const insn)
+#define VERIFY(check) \
+    if (unlikely((error = (check)))) { \
+        return error; \
+    }
+
+/*
+ * Everything that can be told about an instruction without running it is
+ * checked once before execution, so that the handlers only need to look at
+ * the state of the machine.
+ */
+static int verify_insn(const uint64_t ip, const struct exec_insn *const insn)
 {
-    assert(insn->op == CODEGEN_OP_WAIT);
+    int error;
 
-    const uint8_t qnt_signd = insn->wait.quaint.signd;
-    const uint8_t qnt_indirect = insn->wait.quaint.indirect;
-    const uint64_t qnt_size = opd_size(&insn->wait.quaint);
+    switch (insn->op) {
+    case CODEGEN_OP_NOP:
+    case CODEGEN_OP_NOINT:
+    case CODEGEN_OP_INT:
+    case CODEGEN_OP_WLAB:
+        break;
 
-    LEGAL_IF(qnt_signd == 0, "%u", qnt_signd);
-    LEGAL_IF(qnt_indirect == 0 || qnt_indirect == 1, "%u", qnt_indirect);
-    LEGAL_IF(qnt_size == 8, "%" PRIu64, qnt_size);
+    case CODEGEN_OP_MOV:
+    case CODEGEN_OP_CAST:
+        VERIFY(verify_opd(ip, &insn->un.dst));
+        VERIFY(verify_opd(ip, &insn->un.src));
 
-    struct qvm *const qvm = (struct qvm *) (uintptr_t)
-        *(uint64_t *) opd_val(&insn->wait.quaint);
+        LEGAL_AT(ip, insn->op == CODEGEN_OP_CAST ||
+            opd_size(&insn->un.dst) == opd_size(&insn->un.src), "differing sizes");
 
-    if (!qvm || qvm->at_end) {
-        return vm->ip++, EXEC_OK;
-    }
+        break;
 
-    uint64_t tm_val;
+    case CODEGEN_OP_ADD:
+    case CODEGEN_OP_SUB:
+    case CODEGEN_OP_MUL:
+    case CODEGEN_OP_DIV:
+    case CODEGEN_OP_MOD:
+    case CODEGEN_OP_LSH:
+    case CODEGEN_OP_RSH:
+    case CODEGEN_OP_AND:
+    case CODEGEN_OP_XOR:
+    case CODEGEN_OP_OR:
+        VERIFY(verify_scalar(ip, &insn->bin.dst));
+        VERIFY(verify_scalar(ip, &insn->bin.src1));
+        VERIFY(verify_scalar(ip, &insn->bin.src2));
 
-    if (insn->wait.has_timeout) {
-        const uint8_t tm_signd = insn->wait.timeout.signd;
-        const uint8_t tm_indirect = insn->wait.timeout.indirect;
-        const uint64_t tm_size = opd_size(&insn->wait.timeout);
+        LEGAL_AT(ip, insn->bin.dst.signd == insn->bin.src1.signd &&
+            insn->bin.src1.signd == insn->bin.src2.signd, "differing signedness");
 
-        LEGAL_IF(tm_signd == 0, "%u", tm_signd);
-        LEGAL_IF(tm_indirect == 0 || tm_indirect == 1, "%u", tm_indirect);
-        LEGAL_IF(powerof2(tm_size) && tm_size <= 8, "%" PRIu64, tm_size);
+        LEGAL_AT(ip, opd_size(&insn->bin.dst) == opd_size(&insn->bin.src1) &&
+            opd_size(&insn->bin.src1) == opd_size(&insn->bin.src2), "differing sizes");
 
-        const void *const tm = opd_val(&insn->wait.timeout);
+        break;
 
-        switch (tm_size) {
-        case 1: tm_val = *( uint8_t *) tm; break;
-        case 2: tm_val = *(uint16_t *) tm; break;
-        case 4: tm_val = *(uint32_t *) tm; break;
-        case 8: tm_val = *(uint64_t *) tm; break;
-        }
+    case CODEGEN_OP_EQU:
+    case CODEGEN_OP_NEQ:
+        VERIFY(verify_opd(ip, &insn->bin.dst));
+        VERIFY(verify_opd(ip, &insn->bin.src1));
+        VERIFY(verify_opd(ip, &insn->bin.src2));
+        LEGAL_AT(ip, insn->bin.dst.signd == 0, "%u", insn->bin.dst.signd);
+        LEGAL_AT(ip, opd_size(&insn->bin.dst) == 1, "%" PRIu64, opd_size(&insn->bin.dst));
 
-        if (!tm_val) {
-            return vm->ip++, EXEC_OK;
-        }
+        LEGAL_AT(ip, opd_size(&insn->bin.src1) == opd_size(&insn->bin.src2),
+            "differing sizes");
 
-        tm_val *= insn->wait.units ? (uint64_t) 1000000000 : (uint64_t) 1000000;
-    }
+        break;
 
-    vm->waiting = 1;
-    vm->waiting_for = vm->waiting_until = 0;
-    vm->waiting_noblock = insn->wait.noblock;
+    case CODEGEN_OP_LT:
+    case CODEGEN_OP_GT:
+    case CODEGEN_OP_LTE:
+    case CODEGEN_OP_GTE:
+        VERIFY(verify_opd(ip, &insn->bin.dst));
+        VERIFY(verify_scalar(ip, &insn->bin.src1));
+        VERIFY(verify_scalar(ip, &insn->bin.src2));
+        LEGAL_AT(ip, insn->bin.dst.signd == 0, "%u", insn->bin.dst.signd);
+        LEGAL_AT(ip, opd_size(&insn->bin.dst) == 1, "%" PRIu64, opd_size(&insn->bin.dst));
+        LEGAL_AT(ip, insn->bin.src1.signd == insn->bin.src2.signd, "differing signedness");
 
-    if (insn->wait.has_timeout) {
-        vm->waiting_for = 1;
+        LEGAL_AT(ip, opd_size(&insn->bin.src1) == opd_size(&insn->bin.src2),
+            "differing sizes");
 
-        if (unlikely(get_monotonic_time(&now))) {
-            return EXEC_NOMEM;
+        break;
+
+    case CODEGEN_OP_NOT:
+    case CODEGEN_OP_NEG:
+    case CODEGEN_OP_BNEG:
+    case CODEGEN_OP_INCP:
+    case CODEGEN_OP_DECP:
+        VERIFY(verify_scalar(ip, &insn->un.dst));
+        VERIFY(verify_scalar(ip, &insn->un.src));
+
+        LEGAL_AT(ip, opd_size(&insn->un.dst) == opd_size(&insn->un.src),
+            "differing sizes");
+
+        if (insn->op == CODEGEN_OP_NEG) {
+            LEGAL_AT(ip, insn->un.dst.signd == 1, "%u", insn->un.dst.signd);
+        } else if (insn->op == CODEGEN_OP_BNEG) {
+            LEGAL_AT(ip, insn->un.dst.signd == 0, "%u", insn->un.dst.signd);
+            LEGAL_AT(ip, insn->un.src.signd == 0, "%u", insn->un.src.signd);
+        } else {
+            LEGAL_AT(ip, insn->un.dst.signd == insn->un.src.signd, "differing signedness");
         }
 
-        vm->wait_for.start = now;
-        vm->wait_for.interval = tm_val;
-    } else if (insn->wait.func) {
-        vm->waiting_until = 1;
-        vm->wait_until.func = insn->wait.func;
-        vm->wait_until.id = insn->wait.wlab_id;
-    }
+        break;
 
-    qvm->parent = vm;
-    vm = qvm;
-    return EXEC_OK;
-}
+    case CODEGEN_OP_OZ:
+        VERIFY(verify_opd(ip, &insn->un.dst));
+        VERIFY(verify_scalar(ip, &insn->un.src));
+        LEGAL_AT(ip, insn->un.dst.signd == 0, "%u", insn->un.dst.signd);
+        LEGAL_AT(ip, opd_size(&insn->un.dst) == 1, "%" PRIu64, opd_size(&insn->un.dst));
+        break;
 
-static int insn_wlab(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_WLAB);
-    vm->last_passed.func = insn->wlab.func;
-    vm->last_passed.id = insn->wlab.id;
-    return EXEC_OK;
-}
+    case CODEGEN_OP_INC:
+    case CODEGEN_OP_DEC:
+        VERIFY(verify_scalar(ip, &insn->dst));
+        break;
 
-static int insn_getsp(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_GETSP);
+    case CODEGEN_OP_JZ:
+    case CODEGEN_OP_JNZ:
+        VERIFY(verify_opd(ip, &insn->jmp.cond));
+        /* fallthrough */
 
-    const uint8_t dst_is_temp = insn->dst.opd == CODEGEN_OPD_TEMP;
-    const uint8_t dst_signd = insn->dst.signd;
-    const uint8_t dst_indirect = insn->dst.indirect;
-    const uint64_t dst_size = opd_size(&insn->dst);
+    case CODEGEN_OP_JMP:
+        LEGAL_AT(ip, insn->jmp.loc < o->insn_count, "%" PRIu32, insn->jmp.loc);
+        break;
 
-    LEGAL_IF(dst_is_temp == 1, "%u", dst_is_temp);
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_indirect == 0, "%u", dst_indirect);
-    LEGAL_IF(dst_size == 8, "%" PRIu64, dst_size);
+    case CODEGEN_OP_PUSHR:
+        VERIFY(verify_loc(ip, &insn->push.val));
+        VERIFY(verify_word(ip, &insn->push.ssp, CODEGEN_OPD_TEMP));
+        LEGAL_AT(ip, insn->push.val.opd == CODEGEN_OPD_IMM, "%u", insn->push.val.opd);
+        LEGAL_AT(ip, insn->push.ssp.indirect == 0, "%u", insn->push.ssp.indirect);
+        break;
 
-    *((uint64_t *) opd_val(&insn->dst)) = vm->sp;
-    return EXEC_OK;
-}
+    case CODEGEN_OP_PUSH:
+        VERIFY(verify_opd(ip, &insn->push.val));
+        break;
 
-static int insn_qnt(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_QNT);
+    case CODEGEN_OP_CALLV:
+        VERIFY(verify_opd(ip, &insn->call.val));
+        /* fallthrough */
+
+    case CODEGEN_OP_CALL:
+        VERIFY(verify_loc(ip, &insn->call.loc));
+        VERIFY(verify_word(ip, &insn->call.bp, CODEGEN_OPD_TEMP));
+        LEGAL_AT(ip, insn->call.bp.indirect == 0, "%u", insn->call.bp.indirect);
+        break;
 
-    const uint8_t dst_signd = insn->qnt.dst.signd;
-    const uint8_t dst_indirect = insn->qnt.dst.indirect;
-    const uint64_t dst_size = opd_size(&insn->qnt.dst);
+    case CODEGEN_OP_INCSP:
+        VERIFY(verify_word(ip, &insn->incsp.addend, CODEGEN_OPD_IMM));
+        VERIFY(verify_word(ip, &insn->incsp.tsize, CODEGEN_OPD_IMM));
+        VERIFY(verify_word(ip, &insn->incsp.stack, CODEGEN_OPD_IMM));
 
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_indirect == 0, "%u", dst_indirect);
-    LEGAL_IF(dst_size == 8, "%" PRIu64, dst_size);
+        LEGAL_AT(ip, imms[insn->incsp.addend.off] % 8 == 0, "%" PRIu64,
+            imms[insn->incsp.addend.off]);
 
-    const uint8_t loc_signd = insn->qnt.loc.signd;
-    const uint8_t loc_indirect = insn->qnt.loc.indirect;
-    const uint64_t loc_size = opd_size(&insn->qnt.loc);
+        break;
 
-    LEGAL_IF(loc_signd == 0, "%u", loc_signd);
-    LEGAL_IF(loc_indirect == 0 || loc_indirect == 1, "%u", loc_indirect);
-    LEGAL_IF(loc_size == 8, "%" PRIu64, loc_size);
+    case CODEGEN_OP_RETV:
+        VERIFY(verify_opd(ip, &insn->ret.val));
+        /* fallthrough */
 
-    const uint8_t ssp_is_temp = insn->qnt.sp.opd == CODEGEN_OPD_TEMP;
-    const uint8_t ssp_signd = insn->qnt.sp.signd;
-    const uint8_t ssp_indirect = insn->qnt.sp.indirect;
-    const uint64_t ssp_size = opd_size(&insn->qnt.sp);
+    case CODEGEN_OP_RET:
+        VERIFY(verify_word(ip, &insn->ret.size, CODEGEN_OPD_IMM));
+        break;
 
-    LEGAL_IF(ssp_is_temp == 1, "%u", ssp_is_temp);
-    LEGAL_IF(ssp_signd == 0, "%u", ssp_signd);
-    LEGAL_IF(ssp_indirect == 0, "%u", ssp_indirect);
-    LEGAL_IF(ssp_size == 8, "%" PRIu64, ssp_size);
+    case CODEGEN_OP_REF:
+        VERIFY(verify_word(ip, &insn->un.dst, -1));
+        VERIFY(verify_opd(ip, &insn->un.src));
+        LEGAL_AT(ip, insn->un.dst.indirect == 0, "%u", insn->un.dst.indirect);
+        break;
 
-    uint64_t *const dst = opd_val(&insn->qnt.dst);
-    const uint64_t loc = *(uint64_t *) opd_val(&insn->qnt.loc);
-    const uint64_t ssp = *(uint64_t *) opd_val(&insn->qnt.sp);
+    case CODEGEN_OP_DRF:
+        VERIFY(verify_opd(ip, &insn->un.dst));
+        VERIFY(verify_word(ip, &insn->un.src, -1));
+        LEGAL_AT(ip, insn->un.dst.indirect == 0, "%u", insn->un.dst.indirect);
+        break;
 
-    struct qvm *const qvm = calloc(1, sizeof(struct qvm) + STACK_SIZE);
+    case CODEGEN_OP_RTEV:
+        VERIFY(verify_opd(ip, &insn->un.dst));
+        LEGAL_AT(ip, insn->un.dst.indirect == 0, "%u", insn->un.dst.indirect);
+        /* fallthrough */
 
-    if (!qvm) {
-        return EXEC_NOMEM;
-    }
+    case CODEGEN_OP_RTE:
+        VERIFY(verify_word(ip, &insn->un.src, -1));
+        break;
 
-    qvm->ip = loc;
-    qvm->bp = 8 * 2;
-    qvm->sp = qvm->bp + vm->sp - ssp;
-    qvm->at_start = 1;
-    memcpy(qvm->stack + qvm->bp, vm->stack + ssp, (size_t) (vm->sp - ssp));
-    *dst = (uint64_t) (uintptr_t) qvm;
-    vm->sp = ssp;
-    return EXEC_OK;
-}
+    case CODEGEN_OP_QAT:
+        VERIFY(verify_opd(ip, &insn->qat.dst));
+        VERIFY(verify_word(ip, &insn->qat.quaint, -1));
+        LEGAL_AT(ip, insn->qat.dst.signd == 0, "%u", insn->qat.dst.signd);
+        LEGAL_AT(ip, insn->qat.dst.indirect == 0, "%u", insn->qat.dst.indirect);
+        LEGAL_AT(ip, opd_size(&insn->qat.dst) == 1, "%" PRIu64, opd_size(&insn->qat.dst));
+        break;
 
-static int insn_qntv(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_QNTV);
+    case CODEGEN_OP_WAIT:
+        VERIFY(verify_word(ip, &insn->wait.quaint, -1));
 
-    const uint8_t dst_signd = insn->qntv.dst.signd;
-    const uint8_t dst_indirect = insn->qntv.dst.indirect;
-    const uint64_t dst_size = opd_size(&insn->qntv.dst);
+        if (insn->wait.has_timeout) {
+            VERIFY(verify_scalar(ip, &insn->wait.timeout));
+            LEGAL_AT(ip, insn->wait.timeout.signd == 0, "%u", insn->wait.timeout.signd);
+        }
 
-    LEGAL_IF(dst_signd == 0, "%u", dst_signd);
-    LEGAL_IF(dst_indirect == 0, "%u", dst_indirect);
-    LEGAL_IF(dst_size == 8, "%" PRIu64, dst_size);
+        break;
 
-    const uint8_t val_signd = insn->qntv.val.signd;
-    const uint8_t val_indirect = insn->qntv.val.indirect;
-    const uint64_t val_size = opd_size(&insn->qntv.val);
+    case CODEGEN_OP_GETSP:
+        VERIFY(verify_word(ip, &insn->dst, CODEGEN_OPD_TEMP));
+        LEGAL_AT(ip, insn->dst.indirect == 0, "%u", insn->dst.indirect);
+        break;
 
-    LEGAL_IF(val_signd == 0 || val_signd == 1, "%u", val_signd);
-    LEGAL_IF(val_indirect == 0 || val_indirect == 1, "%u", val_indirect);
-    LEGAL_IF(val_size > 0, "%" PRIu64, val_size);
+    case CODEGEN_OP_QNT:
+        VERIFY(verify_word(ip, &insn->qnt.dst, -1));
+        VERIFY(verify_loc(ip, &insn->qnt.loc));
+        VERIFY(verify_word(ip, &insn->qnt.sp, CODEGEN_OPD_TEMP));
+        LEGAL_AT(ip, insn->qnt.dst.indirect == 0, "%u", insn->qnt.dst.indirect);
+        LEGAL_AT(ip, insn->qnt.sp.indirect == 0, "%u", insn->qnt.sp.indirect);
+        break;
 
-    uint64_t *const dst = opd_val(&insn->qntv.dst);
-    const void *const val = opd_val(&insn->qntv.val);
+    case CODEGEN_OP_QNTV:
+        VERIFY(verify_word(ip, &insn->qntv.dst, -1));
+        VERIFY(verify_opd(ip, &insn->qntv.val));
+        LEGAL_AT(ip, insn->qntv.dst.indirect == 0, "%u", insn->qntv.dst.indirect);
+        LEGAL_AT(ip, opd_size(&insn->qntv.val) <= STACK_SIZE, "%" PRIu64,
+            opd_size(&insn->qntv.val));
 
-    struct qvm *const qvm = calloc(1, sizeof(struct qvm) + STACK_SIZE);
+        break;
 
-    if (!qvm) {
-        return EXEC_NOMEM;
+    case CODEGEN_OP_BFUN:
+        LEGAL_AT(ip, ip < SCOPE_BFUN_ID_COUNT, "%" PRIu64, ip);
+        break;
+
+    default: LEGAL_AT(ip, false, "unknown instruction: %u", insn->op);
     }
 
-    qvm->at_start = 1;
-    qvm->at_end = 1;
-    memcpy(qvm->stack, val, (size_t) val_size);
-    *dst = (uint64_t) (uintptr_t) qvm;
     return EXEC_OK;
 }
 
-static int insn_noint_int(const struct codegen_insn *const insn)
+#undef VERIFY
+
+static int verify(void)
 {
-    assert(insn->op == CODEGEN_OP_NOINT || insn->op == CODEGEN_OP_INT);
-    vm->noint = insn->op == CODEGEN_OP_NOINT;
+    for (uint64_t ip = 0; ip < o->insn_count; ++ip) {
+        const int error = verify_insn(ip, &insns[ip]);
+
+        if (unlikely(error)) {
+            return error;
+        }
+    }
+
     return EXEC_OK;
 }
 
-static int insn_bfun(const struct codegen_insn *const insn)
-{
-    assert(insn->op == CODEGEN_OP_BFUN);
-
-    LEGAL_IF(vm->sp % 8 == 0, "%" PRIu64, vm->sp);
-    LEGAL_IF(vm->bp % 8 == 0, "%" PRIu64, vm->bp);
-    LEGAL_IF(vm->sp >= 16, "%" PRIu64, vm->sp);
+/*
+ * Quickening: before running, every instruction whose operands are plain
+ * (not indirect) temporaries or autos of a scalar type is rewritten into a
+ * variant specialised for its operation, type and operand kinds, so that
+ * its handler neither decodes operands nor switches on sizes. Everything
+ * else goes through the generic insn_*() handlers.
+ *
+ * The variants are generated from the lists below. A list calls its
+ * consumer X once per variant with the name of the operation, the C
+ * operator implementing it, the type (short name and C type) and the kinds
+ * of the operands it is specialised for (T for a temporary, A for an auto,
+ * G for a global), as described above each list.
+ */
+#define QUICK_UTYPES(Y, ...) \
+    Y(__VA_ARGS__, u8, uint8_t) Y(__VA_ARGS__, u16, uint16_t) \
+    Y(__VA_ARGS__, u32, uint32_t) Y(__VA_ARGS__, u64, uint64_t)
+
+/* the same as QUICK_UTYPES, for the source type of a cast */
+#define QUICK_STYPES(Y, ...) \
+    Y(__VA_ARGS__, u8, uint8_t) Y(__VA_ARGS__, u16, uint16_t) \
+    Y(__VA_ARGS__, u32, uint32_t) Y(__VA_ARGS__, u64, uint64_t)
+
+/* for operations whose result depends on signedness */
+#define QUICK_TYPES(Y, ...) \
+    Y(__VA_ARGS__, u8, uint8_t) Y(__VA_ARGS__, i8, int8_t) \
+    Y(__VA_ARGS__, u16, uint16_t) Y(__VA_ARGS__, i16, int16_t) \
+    Y(__VA_ARGS__, u32, uint32_t) Y(__VA_ARGS__, i32, int32_t) \
+    Y(__VA_ARGS__, u64, uint64_t) Y(__VA_ARGS__, i64, int64_t)
+
+#define QUICK_KIND(Y, ...) Y(__VA_ARGS__, T) Y(__VA_ARGS__, A) Y(__VA_ARGS__, G)
+#define QUICK_KIND_COUNT 3
+
+#define QUICK_KINDS(Y, ...) \
+    Y(__VA_ARGS__, T, T) Y(__VA_ARGS__, T, A) Y(__VA_ARGS__, T, G) \
+    Y(__VA_ARGS__, A, T) Y(__VA_ARGS__, A, A) Y(__VA_ARGS__, A, G) \
+    Y(__VA_ARGS__, G, T) Y(__VA_ARGS__, G, A) Y(__VA_ARGS__, G, G)
+
+/* T dst = K1 src1 op K2 src2 */
+#define QUICK_BIN(X) \
+    QUICK_UTYPES(QUICK_KINDS, X, add, +) \
+    QUICK_UTYPES(QUICK_KINDS, X, sub, -) \
+    QUICK_UTYPES(QUICK_KINDS, X, mul, *) \
+    QUICK_UTYPES(QUICK_KINDS, X, lsh, <<) \
+    QUICK_UTYPES(QUICK_KINDS, X, rsh, >>) \
+    QUICK_UTYPES(QUICK_KINDS, X, and, &) \
+    QUICK_UTYPES(QUICK_KINDS, X, xor, ^) \
+    QUICK_UTYPES(QUICK_KINDS, X, or, |) \
+    QUICK_TYPES(QUICK_KINDS, X, div, /) \
+    QUICK_TYPES(QUICK_KINDS, X, mod, %)
+
+/* T u8 dst = K1 src1 op K2 src2 */
+#define QUICK_CMP(X) \
+    QUICK_UTYPES(QUICK_KINDS, X, equ, ==) \
+    QUICK_UTYPES(QUICK_KINDS, X, neq, !=) \
+    QUICK_TYPES(QUICK_KINDS, X, lt, <) \
+    QUICK_TYPES(QUICK_KINDS, X, gt, >) \
+    QUICK_TYPES(QUICK_KINDS, X, lte, <=) \
+    QUICK_TYPES(QUICK_KINDS, X, gte, >=)
+
+/* K1 dst = K2 src */
+#define QUICK_MOV(X) \
+    QUICK_UTYPES(QUICK_KINDS, X, mov, =)
+
+/* T dst = op K src */
+#define QUICK_UN(X) \
+    QUICK_UTYPES(QUICK_KIND, X, not, !) \
+    QUICK_UTYPES(QUICK_KIND, X, neg, -) \
+    QUICK_UTYPES(QUICK_KIND, X, bneg, ~)
+
+/* T u8 dst = op K src */
+#define QUICK_OZ(X) \
+    QUICK_UTYPES(QUICK_KIND, X, oz, !!)
+
+/* T dst = (K src)op */
+#define QUICK_INCP(X) \
+    QUICK_UTYPES(QUICK_KIND, X, incp, ++) \
+    QUICK_UTYPES(QUICK_KIND, X, decp, --)
+
+/* op K dst */
+#define QUICK_INC(X) \
+    QUICK_UTYPES(QUICK_KIND, X, inc, ++) \
+    QUICK_UTYPES(QUICK_KIND, X, dec, --)
+
+/* K dst = immediate, a mov or a cast of a literal */
+#define QUICK_LDI(X) \
+    QUICK_UTYPES(QUICK_KIND, X, ldi, =)
+
+/* jump if K cond op 0 */
+#define QUICK_CJMP(X) \
+    QUICK_UTYPES(QUICK_KIND, X, jz, ==) \
+    QUICK_UTYPES(QUICK_KIND, X, jnz, !=)
+
+/* T dst = (dst type) K src, zero-extending */
+#define QUICK_CAST_FROM(X, name, op, dty, dtype) \
+    QUICK_STYPES(QUICK_KIND, X, name, op, dty, dtype)
+
+#define QUICK_CAST(X) \
+    QUICK_UTYPES(QUICK_CAST_FROM, X, cast, =)
+
+/*
+ * Superinstructions: the variants below each stand for a sequence of
+ * instructions codegen commonly emits and are selected by fuse() after
+ * quickening. Only the first instruction of a sequence is replaced, the
+ * others keep their own handlers for when they are jumped to directly.
+ */
+
+/*
+ * T u8 dst = K src1 op T src2, then the jz or jnz on dst that follows,
+ * optionally preceded by the load of a literal into src2 (QUICK_NAMEIJ)
+ */
+#define QUICK_CMPJ(X) \
+    QUICK_UTYPES(QUICK_KIND, X, equ, ==) \
+    QUICK_UTYPES(QUICK_KIND, X, neq, !=) \
+    QUICK_TYPES(QUICK_KIND, X, lt, <) \
+    QUICK_TYPES(QUICK_KIND, X, gt, >) \
+    QUICK_TYPES(QUICK_KIND, X, lte, <=) \
+    QUICK_TYPES(QUICK_KIND, X, gte, >=)
+
+/* T u64 dst = (u64) K src op immediate, a cast followed by a mul of an index */
+#define QUICK_SCALE(X) \
+    QUICK_UTYPES(QUICK_KIND, X, scale, *)
+
+/* T u64 dst = *K src op immediate, a drf followed by the add of a member offset */
+#define QUICK_MEMB(X) \
+    QUICK_KIND(X, memb, +, u64, uint64_t)
+
+/* the generic handlers, one per group of codegen instructions */
+#define EXEC_GENERIC_OPS(X) \
+    X(nop) X(mov) X(cast) X(bin_arith) X(equ_neq) X(bin_logic) \
+    X(not) X(neg) X(bneg) X(oz) X(inc_dec) X(incp_decp) X(cjmp) X(jmp) \
+    X(pushr) X(push) X(call_callv) X(incsp) X(ret_retv) X(ref) X(drf) \
+    X(rte_rtev) X(qat) X(wait) X(wlab) X(getsp) X(qnt) X(qntv) \
+    X(noint_int) X(bfun) X(halt)
+
+#define QUICK_NAME2(name, op, ty, type, k1, k2) name##_##ty##_##k1##k2
+#define QUICK_NAME1(name, op, ty, type, k) name##_##ty##_##k
+#define QUICK_NAMEC(name, op, dty, dtype, sty, stype, k) name##_##dty##_##sty##_##k
+#define QUICK_NAMEJ(name, op, ty, type, k) name##_##ty##_##k##T_jmp
+#define QUICK_NAMEIJ(name, op, ty, type, k) ldi_##name##_##ty##_##k##T_jmp
+
+enum {
+    #define GENERIC_ID(name) EXEC_OP_##name,
+    #define QUICK_ID2(...) QUICK_ID(QUICK_NAME2(__VA_ARGS__))
+    #define QUICK_ID1(...) QUICK_ID(QUICK_NAME1(__VA_ARGS__))
+    #define QUICK_IDC(...) QUICK_ID(QUICK_NAMEC(__VA_ARGS__))
+    #define QUICK_IDJ(...) QUICK_ID(QUICK_NAMEJ(__VA_ARGS__))
+    #define QUICK_IDIJ(...) QUICK_ID(QUICK_NAMEIJ(__VA_ARGS__))
+    #define QUICK_ID(name) GENERIC_ID(name)
+
+    EXEC_GENERIC_OPS(GENERIC_ID)
+    QUICK_BIN(QUICK_ID2)
+    QUICK_CMP(QUICK_ID2)
+    QUICK_MOV(QUICK_ID2)
+    QUICK_UN(QUICK_ID1)
+    QUICK_OZ(QUICK_ID1)
+    QUICK_INCP(QUICK_ID1)
+    QUICK_INC(QUICK_ID1)
+    QUICK_LDI(QUICK_ID1)
+    QUICK_CJMP(QUICK_ID1)
+    QUICK_CAST(QUICK_IDC)
+    QUICK_CMPJ(QUICK_IDJ)
+    QUICK_CMPJ(QUICK_IDIJ)
+    QUICK_SCALE(QUICK_ID1)
+    QUICK_MEMB(QUICK_ID1)
+
+    #undef QUICK_ID
+    #undef QUICK_IDIJ
+    #undef QUICK_IDJ
+    #undef QUICK_IDC
+    #undef QUICK_ID1
+    #undef QUICK_ID2
+    #undef GENERIC_ID
+
+    EXEC_OP_COUNT,
+};
 
-    uint64_t retval_size = 0;
-    const void *retval = NULL;
+static_assert(EXEC_OP_COUNT - 1 <= UINT16_MAX, "");
+/* 0 for a temporary, 1 for an auto, 2 for a global, -1 if there is no quick variant */
+static int quick_kind(const struct exec_opd *const operand)
+{
+    if (operand->indirect) {
+        return -1;
+    }
 
-    switch (vm->ip) {
-    case SCOPE_BFUN_ID_NULL:
-        LEGAL_IF(0, "null function call");
-        break;
+    switch (operand->opd) {
+    case CODEGEN_OPD_TEMP: return 0;
+    case CODEGEN_OPD_AUTO: return 1;
+    case CODEGEN_OPD_GLOB: return 2;
+    default: return -1;
+    }
+}
 
-    case SCOPE_BFUN_ID_MONOTIME:
-        if (unlikely(get_monotonic_time(&now))) {
-            return EXEC_NOMEM;
-        }
+/* log2 of the size of a scalar operand, -1 for anything else */
+static int quick_size(const struct exec_opd *const operand)
+{
+    switch (opd_size(operand)) {
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    case 8: return 3;
+    default: return -1;
+    }
+}
 
-        retval_size = sizeof(now);
-        retval = &now;
-        break;
+static exec_op_t quicken(const struct exec_insn *const insn)
+{
+    static const exec_op_t generic[CODEGEN_OP_COUNT] = {
+        [CODEGEN_OP_NOP]   = EXEC_OP_nop,
+        [CODEGEN_OP_MOV]   = EXEC_OP_mov,
+        [CODEGEN_OP_CAST]  = EXEC_OP_cast,
+        [CODEGEN_OP_ADD]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_SUB]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_MUL]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_DIV]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_MOD]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_EQU]   = EXEC_OP_equ_neq,
+        [CODEGEN_OP_NEQ]   = EXEC_OP_equ_neq,
+        [CODEGEN_OP_LT]    = EXEC_OP_bin_logic,
+        [CODEGEN_OP_GT]    = EXEC_OP_bin_logic,
+        [CODEGEN_OP_LTE]   = EXEC_OP_bin_logic,
+        [CODEGEN_OP_GTE]   = EXEC_OP_bin_logic,
+        [CODEGEN_OP_LSH]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_RSH]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_AND]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_XOR]   = EXEC_OP_bin_arith,
+        [CODEGEN_OP_OR]    = EXEC_OP_bin_arith,
+        [CODEGEN_OP_NOT]   = EXEC_OP_not,
+        [CODEGEN_OP_NEG]   = EXEC_OP_neg,
+        [CODEGEN_OP_BNEG]  = EXEC_OP_bneg,
+        [CODEGEN_OP_OZ]    = EXEC_OP_oz,
+        [CODEGEN_OP_INC]   = EXEC_OP_inc_dec,
+        [CODEGEN_OP_DEC]   = EXEC_OP_inc_dec,
+        [CODEGEN_OP_INCP]  = EXEC_OP_incp_decp,
+        [CODEGEN_OP_DECP]  = EXEC_OP_incp_decp,
+        [CODEGEN_OP_JZ]    = EXEC_OP_cjmp,
+        [CODEGEN_OP_JNZ]   = EXEC_OP_cjmp,
+        [CODEGEN_OP_JMP]   = EXEC_OP_jmp,
+        [CODEGEN_OP_PUSHR] = EXEC_OP_pushr,
+        [CODEGEN_OP_PUSH]  = EXEC_OP_push,
+        [CODEGEN_OP_CALL]  = EXEC_OP_call_callv,
+        [CODEGEN_OP_CALLV] = EXEC_OP_call_callv,
+        [CODEGEN_OP_INCSP] = EXEC_OP_incsp,
+        [CODEGEN_OP_RET]   = EXEC_OP_ret_retv,
+        [CODEGEN_OP_RETV]  = EXEC_OP_ret_retv,
+        [CODEGEN_OP_REF]   = EXEC_OP_ref,
+        [CODEGEN_OP_DRF]   = EXEC_OP_drf,
+        [CODEGEN_OP_RTE]   = EXEC_OP_rte_rtev,
+        [CODEGEN_OP_RTEV]  = EXEC_OP_rte_rtev,
+        [CODEGEN_OP_QAT]   = EXEC_OP_qat,
+        [CODEGEN_OP_WAIT]  = EXEC_OP_wait,
+        [CODEGEN_OP_WLAB]  = EXEC_OP_wlab,
+        [CODEGEN_OP_GETSP] = EXEC_OP_getsp,
+        [CODEGEN_OP_QNT]   = EXEC_OP_qnt,
+        [CODEGEN_OP_QNTV]  = EXEC_OP_qntv,
+        [CODEGEN_OP_NOINT] = EXEC_OP_noint_int,
+        [CODEGEN_OP_INT]   = EXEC_OP_noint_int,
+        [CODEGEN_OP_BFUN]  = EXEC_OP_bfun,
+    };
 
-    case SCOPE_BFUN_ID_MALLOC:
-    case SCOPE_BFUN_ID_CALLOC: {
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 8 <= STACK_SIZE, "%" PRIu64, vm->bp);
-        retval_size = 8;
-        const size_t size = (size_t) *(uint64_t *) (vm->stack + vm->bp);
+    /*
+     * The variants of an operation are laid out type by type and, within a
+     * type, kind by kind, so the first one plus an index picks the variant.
+     */
+    exec_op_t first;
+    bool signd = false;
 
-        const uint64_t mem = vm->ip == SCOPE_BFUN_ID_MALLOC ?
-            (uint64_t) (uintptr_t) malloc(size) : (uint64_t) (uintptr_t) calloc(1, size);
+    switch (insn->op) {
+    case CODEGEN_OP_ADD: first = EXEC_OP_add_u8_TT; break;
+    case CODEGEN_OP_SUB: first = EXEC_OP_sub_u8_TT; break;
+    case CODEGEN_OP_MUL: first = EXEC_OP_mul_u8_TT; break;
+    case CODEGEN_OP_LSH: first = EXEC_OP_lsh_u8_TT; break;
+    case CODEGEN_OP_AND: first = EXEC_OP_and_u8_TT; break;
+    case CODEGEN_OP_XOR: first = EXEC_OP_xor_u8_TT; break;
+    case CODEGEN_OP_OR:  first = EXEC_OP_or_u8_TT; break;
+    case CODEGEN_OP_DIV: first = EXEC_OP_div_u8_TT, signd = true; break;
+    case CODEGEN_OP_MOD: first = EXEC_OP_mod_u8_TT, signd = true; break;
+    case CODEGEN_OP_RSH: first = EXEC_OP_rsh_u8_TT; break;
+    case CODEGEN_OP_EQU: first = EXEC_OP_equ_u8_TT; break;
+    case CODEGEN_OP_NEQ: first = EXEC_OP_neq_u8_TT; break;
+    case CODEGEN_OP_LT:  first = EXEC_OP_lt_u8_TT, signd = true; break;
+    case CODEGEN_OP_GT:  first = EXEC_OP_gt_u8_TT, signd = true; break;
+    case CODEGEN_OP_LTE: first = EXEC_OP_lte_u8_TT, signd = true; break;
+    case CODEGEN_OP_GTE: first = EXEC_OP_gte_u8_TT, signd = true; break;
+    case CODEGEN_OP_NOT: first = EXEC_OP_not_u8_T; break;
+    case CODEGEN_OP_NEG: first = EXEC_OP_neg_u8_T; break;
+    case CODEGEN_OP_BNEG: first = EXEC_OP_bneg_u8_T; break;
+    case CODEGEN_OP_OZ: first = EXEC_OP_oz_u8_T; break;
+    case CODEGEN_OP_INCP: first = EXEC_OP_incp_u8_T; break;
+    case CODEGEN_OP_DECP: first = EXEC_OP_decp_u8_T; break;
+    case CODEGEN_OP_INC: first = EXEC_OP_inc_u8_T; break;
+    case CODEGEN_OP_DEC: first = EXEC_OP_dec_u8_T; break;
+    case CODEGEN_OP_JZ: first = EXEC_OP_jz_u8_T; break;
+    case CODEGEN_OP_JNZ: first = EXEC_OP_jnz_u8_T; break;
+    case CODEGEN_OP_MOV: first = EXEC_OP_mov_u8_TT; break;
+    case CODEGEN_OP_CAST: first = EXEC_OP_cast_u8_u8_T; break;
+    default: return generic[insn->op];
+    }
 
-        retval = &mem;
-        vm->sp -= 8;
-    } break;
+    switch (insn->op) {
+    case CODEGEN_OP_ADD:
+    case CODEGEN_OP_SUB:
+    case CODEGEN_OP_MUL:
+    case CODEGEN_OP_LSH:
+    case CODEGEN_OP_AND:
+    case CODEGEN_OP_XOR:
+    case CODEGEN_OP_OR:
+    case CODEGEN_OP_DIV:
+    case CODEGEN_OP_MOD:
+    case CODEGEN_OP_RSH:
+    case CODEGEN_OP_EQU:
+    case CODEGEN_OP_NEQ:
+    case CODEGEN_OP_LT:
+    case CODEGEN_OP_GT:
+    case CODEGEN_OP_LTE:
+    case CODEGEN_OP_GTE: {
+        const int dst = quick_kind(&insn->bin.dst);
+        const int src1 = quick_kind(&insn->bin.src1);
+        const int src2 = quick_kind(&insn->bin.src2);
+        const int size = quick_size(&insn->bin.src1);
+
+        /* signed shifts are rejected by the type checker, leave them generic */
+        if (dst != 0 || src1 < 0 || src2 < 0 || size < 0 ||
+            (insn->op == CODEGEN_OP_RSH && insn->bin.src1.signd)) {
+            break;
+        }
 
-    case SCOPE_BFUN_ID_REALLOC: {
-        LEGAL_IF(vm->sp >= 16 + 16, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 16 <= STACK_SIZE, "%" PRIu64, vm->bp);
-        retval_size = 8;
-        void *const oldptr = (void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
-        const size_t newsize = (size_t) *(uint64_t *) (vm->stack + vm->bp + 8);
-        const uint64_t mem = (uint64_t) (uintptr_t) realloc(oldptr, newsize);
-        retval = &mem;
-        vm->sp -= 16;
-    } break;
+        const int type = signd ? size * 2 + insn->bin.src1.signd : size;
+        return (exec_op_t) (first + (type * QUICK_KIND_COUNT + src1) * QUICK_KIND_COUNT + src2);
+    }
 
-    case SCOPE_BFUN_ID_FREE: {
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 8 <= STACK_SIZE, "%" PRIu64, vm->bp);
-        void *const ptr = (void *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp);
-        free(ptr);
-        vm->sp -= 8;
-    } break;
+    case CODEGEN_OP_NOT:
+    case CODEGEN_OP_NEG:
+    case CODEGEN_OP_BNEG:
+    case CODEGEN_OP_OZ:
+    case CODEGEN_OP_INCP:
+    case CODEGEN_OP_DECP: {
+        const int dst = quick_kind(&insn->un.dst);
+        const int src = quick_kind(&insn->un.src);
+        const int size = quick_size(&insn->un.src);
 
-    case SCOPE_BFUN_ID_PS:
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 8 <= STACK_SIZE, "%" PRIu64, vm->bp);
-        printf("%s", (const char *) (uintptr_t) *(uint64_t *) (vm->stack + vm->bp));
-        fflush(stdout);
-        vm->sp -= 8;
-        break;
+        if (dst != 0 || src < 0 || size < 0) {
+            break;
+        }
 
-    case SCOPE_BFUN_ID_PU8:
-    case SCOPE_BFUN_ID_PI8:
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 1 <= STACK_SIZE, "%" PRIu64, vm->bp);
+        return (exec_op_t) (first + size * QUICK_KIND_COUNT + src);
+    }
 
-        vm->ip == SCOPE_BFUN_ID_PU8 ?
-            printf("%" PRIu8, *(uint8_t *) (vm->stack + vm->bp)) :
-            printf("%" PRIi8, *(int8_t *) (vm->stack + vm->bp));
+    case CODEGEN_OP_INC:
+    case CODEGEN_OP_DEC: {
+        const int dst = quick_kind(&insn->dst);
+        const int size = quick_size(&insn->dst);
 
-        fflush(stdout);
-        vm->sp -= 8;
-        break;
+        if (dst < 0 || size < 0) {
+            break;
+        }
 
-    case SCOPE_BFUN_ID_PU16:
-    case SCOPE_BFUN_ID_PI16:
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 2 <= STACK_SIZE, "%" PRIu64, vm->bp);
+        return (exec_op_t) (first + size * QUICK_KIND_COUNT + dst);
+    }
 
-        vm->ip == SCOPE_BFUN_ID_PU16 ?
-            printf("%" PRIu16, *(uint16_t *) (vm->stack + vm->bp)) :
-            printf("%" PRIi16, *(int16_t *) (vm->stack + vm->bp));
+    case CODEGEN_OP_JZ:
+    case CODEGEN_OP_JNZ: {
+        const int cond = quick_kind(&insn->jmp.cond);
+        const int size = quick_size(&insn->jmp.cond);
 
-        fflush(stdout);
-        vm->sp -= 8;
-        break;
+        if (cond < 0 || size < 0) {
+            break;
+        }
 
-    case SCOPE_BFUN_ID_PU32:
-    case SCOPE_BFUN_ID_PI32:
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 4 <= STACK_SIZE, "%" PRIu64, vm->bp);
+        return (exec_op_t) (first + size * QUICK_KIND_COUNT + cond);
+    }
 
-        vm->ip == SCOPE_BFUN_ID_PU32 ?
-            printf("%" PRIu32, *(uint32_t *) (vm->stack + vm->bp)) :
-            printf("%" PRIi32, *(int32_t *) (vm->stack + vm->bp));
+    case CODEGEN_OP_MOV:
+    case CODEGEN_OP_CAST: {
+        const struct exec_opd *const src = &insn->un.src;
+        const int dst = quick_kind(&insn->un.dst);
+        const int dst_size = quick_size(&insn->un.dst);
 
-        fflush(stdout);
-        vm->sp -= 8;
-        break;
+        if (dst < 0 || dst_size < 0) {
+            break;
+        }
 
-    case SCOPE_BFUN_ID_PU64:
-    case SCOPE_BFUN_ID_PI64:
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 8 <= STACK_SIZE, "%" PRIu64, vm->bp);
+        /* a literal, as long as it fits in its size it can be truncated */
+        if (src->opd == CODEGEN_OPD_IMM) {
+            if (src->size == 8 || imms[src->off] >> (src->size * 8) == 0) {
+                return (exec_op_t) (EXEC_OP_ldi_u8_T + dst_size * QUICK_KIND_COUNT + dst);
+            }
 
-        vm->ip == SCOPE_BFUN_ID_PU64 ?
-            printf("%" PRIu64, *(uint64_t *) (vm->stack + vm->bp)) :
-            printf("%" PRIi64, *(int64_t *) (vm->stack + vm->bp));
+            break;
+        }
 
-        fflush(stdout);
-        vm->sp -= 8;
-        break;
+        const int src_kind = quick_kind(src);
+        const int src_size = quick_size(src);
 
-    case SCOPE_BFUN_ID_PNL:
-        printf("\n");
-        fflush(stdout);
-        break;
+        if (src_kind < 0 || src_size < 0) {
+            break;
+        }
 
-    case SCOPE_BFUN_ID_EXIT:
-        LEGAL_IF(vm->sp >= 16 + 8, "%" PRIu64, vm->sp);
-        LEGAL_IF(vm->bp + 4 <= STACK_SIZE, "%" PRIu64, vm->bp);
-        vm->sp -= 8;
-        exit(*(int32_t *) (vm->stack + vm->bp));
-        break;
+        if (insn->op == CODEGEN_OP_MOV) {
+            return (exec_op_t) (first +
+                (dst_size * QUICK_KIND_COUNT + dst) * QUICK_KIND_COUNT + src_kind);
+        } else if (dst == 0) {
+            return (exec_op_t) (first +
+                (dst_size * 4 + src_size) * QUICK_KIND_COUNT + src_kind);
+        }
+    } break;
     }
 
-    vm->sp -= 16;
-    struct tmp_frame *const new_tmp_frame = malloc(sizeof(struct tmp_frame));
+    return generic[insn->op];
+}
 
-    if (unlikely(!new_tmp_frame)) {
-        return EXEC_NOMEM;
+static bool same_opd(const struct exec_opd *const lhs, const struct exec_opd *const rhs)
+{
+    return lhs->opd == rhs->opd && lhs->indirect == rhs->indirect &&
+        lhs->off == rhs->off && lhs->size == rhs->size;
+}
+
+/* the compare-and-branch variant of a compare and the jump after it, -1 if none */
+static int fuse_cmpj(const struct exec_insn *const cmp,
+    const struct exec_insn *const branch)
+{
+    int first;
+    bool signd = false;
+
+    switch (cmp->op) {
+    case CODEGEN_OP_EQU: first = EXEC_OP_equ_u8_TT_jmp; break;
+    case CODEGEN_OP_NEQ: first = EXEC_OP_neq_u8_TT_jmp; break;
+    case CODEGEN_OP_LT:  first = EXEC_OP_lt_u8_TT_jmp, signd = true; break;
+    case CODEGEN_OP_GT:  first = EXEC_OP_gt_u8_TT_jmp, signd = true; break;
+    case CODEGEN_OP_LTE: first = EXEC_OP_lte_u8_TT_jmp, signd = true; break;
+    case CODEGEN_OP_GTE: first = EXEC_OP_gte_u8_TT_jmp, signd = true; break;
+    default: return -1;
     }
 
-    new_tmp_frame->prev = vm->temps;
-    vm->temps = new_tmp_frame;
+    const int src1 = quick_kind(&cmp->bin.src1);
+    const int size = quick_size(&cmp->bin.src1);
 
-    return handle_return(insn, retval_size, retval);
+    if (quick_kind(&cmp->bin.dst) != 0 || quick_kind(&cmp->bin.src2) != 0 ||
+        src1 < 0 || size < 0 || opd_size(&cmp->bin.dst) != 1 ||
+        (branch->op != CODEGEN_OP_JZ && branch->op != CODEGEN_OP_JNZ) ||
+        !same_opd(&branch->jmp.cond, &cmp->bin.dst)) {
+        return -1;
+    }
+
+    const int type = signd ? size * 2 + cmp->bin.src1.signd : size;
+    return first + type * QUICK_KIND_COUNT + src1;
 }
 
-static int exec_insn(const struct codegen_insn *const insn)
+/*
+ * Picks the superinstruction for the sequence starting at the given
+ * instruction, whose variant must already be quickened, or leaves it be.
+ */
+static exec_op_t fuse(const uint64_t ip)
 {
-    int result = EXEC_OK;
+    const struct exec_insn *const insn = &insns[ip];
+    const uint64_t left = o->insn_count - ip;
 
     switch (insn->op) {
-    case CODEGEN_OP_NOP:
-        result = EXEC_OK;
-        break;
-
     case CODEGEN_OP_MOV:
-        result = insn_mov(insn);
-        break;
+    case CODEGEN_OP_CAST: {
+        const int dst = quick_kind(&insn->un.dst);
+        const int dst_size = quick_size(&insn->un.dst);
 
-    case CODEGEN_OP_CAST:
-        result = insn_cast(insn);
-        break;
+        if (left >= 3 && dst == 0 && dst_size >= 0 &&
+            insn->quick == EXEC_OP_ldi_u8_T + dst_size * QUICK_KIND_COUNT &&
+            same_opd(&insn->un.dst, &insn[1].bin.src2)) {
+            const int cmpj = fuse_cmpj(insn + 1, insn + 2);
 
-    case CODEGEN_OP_ADD:
-    case CODEGEN_OP_SUB:
-    case CODEGEN_OP_MUL:
-    case CODEGEN_OP_DIV:
-    case CODEGEN_OP_MOD:
-    case CODEGEN_OP_LSH:
-    case CODEGEN_OP_RSH:
-    case CODEGEN_OP_AND:
-    case CODEGEN_OP_XOR:
-    case CODEGEN_OP_OR:
-        result = insn_bin_arith(insn);
-        break;
+            if (cmpj >= 0) {
+                return (exec_op_t) (cmpj - EXEC_OP_equ_u8_TT_jmp + EXEC_OP_ldi_equ_u8_TT_jmp);
+            }
+        }
+
+        const struct exec_insn *const mul = insn + 1;
+        const int src = quick_kind(&insn->un.src);
+        const int src_size = quick_size(&insn->un.src);
+
+        if (left >= 2 && insn->op == CODEGEN_OP_CAST && dst == 0 && dst_size == 3 &&
+            src >= 0 && src_size >= 0 && mul->op == CODEGEN_OP_MUL &&
+            same_opd(&mul->bin.dst, &insn->un.dst) &&
+            same_opd(&mul->bin.src1, &insn->un.dst) &&
+            mul->bin.src2.opd == CODEGEN_OPD_IMM && mul->bin.src2.size == 8) {
+            return (exec_op_t) (EXEC_OP_scale_u8_T + src_size * QUICK_KIND_COUNT + src);
+        }
+    } break;
 
     case CODEGEN_OP_EQU:
     case CODEGEN_OP_NEQ:
-        result = insn_equ_neq(insn);
-        break;
-
     case CODEGEN_OP_LT:
     case CODEGEN_OP_GT:
     case CODEGEN_OP_LTE:
-    case CODEGEN_OP_GTE:
-        result = insn_bin_logic(insn);
-        break;
+    case CODEGEN_OP_GTE: {
+        const int cmpj = left >= 2 ? fuse_cmpj(insn, insn + 1) : -1;
 
-    case CODEGEN_OP_NOT:
-        result = insn_not(insn);
-        break;
+        if (cmpj >= 0) {
+            return (exec_op_t) cmpj;
+        }
+    } break;
 
-    case CODEGEN_OP_NEG:
-        result = insn_neg(insn);
-        break;
+    case CODEGEN_OP_DRF: {
+        const struct exec_insn *const add = insn + 1;
+        const int src = quick_kind(&insn->un.src);
 
-    case CODEGEN_OP_BNEG:
-        result = insn_bneg(insn);
-        break;
+        if (left >= 2 && quick_kind(&insn->un.dst) == 0 && opd_size(&insn->un.dst) == 8 &&
+            src >= 0 && opd_size(&insn->un.src) == 8 && add->op == CODEGEN_OP_ADD &&
+            quick_kind(&add->bin.dst) == 0 && opd_size(&add->bin.dst) == 8 &&
+            same_opd(&add->bin.src1, &insn->un.dst) &&
+            add->bin.src2.opd == CODEGEN_OPD_IMM && add->bin.src2.size == 8) {
+            return (exec_op_t) (EXEC_OP_memb_u64_T + src);
+        }
+    } break;
+    }
 
-    case CODEGEN_OP_OZ:
-        result = insn_oz(insn);
-        break;
+    return insn->quick;
+}
 
-    case CODEGEN_OP_INC:
-    case CODEGEN_OP_DEC:
-        result = insn_inc_dec(insn);
-        break;
+#ifdef EXEC_PAIR_STATS
+/*
+ * Counting of the pairs of handlers executed one right after the other,
+ * printed when the program ends, to pick the superinstructions from.
+ */
+#define PAIR_STATS_TOP 40
+
+static const char *const op_names[EXEC_OP_COUNT] = {
+    #define NAME_OF(name) [EXEC_OP_##name] = #name,
+    #define QUICK_NAME_OF2(...) QUICK_NAME_OF(QUICK_NAME2(__VA_ARGS__))
+    #define QUICK_NAME_OF1(...) QUICK_NAME_OF(QUICK_NAME1(__VA_ARGS__))
+    #define QUICK_NAME_OFC(...) QUICK_NAME_OF(QUICK_NAMEC(__VA_ARGS__))
+    #define QUICK_NAME_OFJ(...) QUICK_NAME_OF(QUICK_NAMEJ(__VA_ARGS__))
+    #define QUICK_NAME_OFIJ(...) QUICK_NAME_OF(QUICK_NAMEIJ(__VA_ARGS__))
+    #define QUICK_NAME_OF(name) NAME_OF(name)
+
+    EXEC_GENERIC_OPS(NAME_OF)
+    QUICK_BIN(QUICK_NAME_OF2)
+    QUICK_CMP(QUICK_NAME_OF2)
+    QUICK_MOV(QUICK_NAME_OF2)
+    QUICK_UN(QUICK_NAME_OF1)
+    QUICK_OZ(QUICK_NAME_OF1)
+    QUICK_INCP(QUICK_NAME_OF1)
+    QUICK_INC(QUICK_NAME_OF1)
+    QUICK_LDI(QUICK_NAME_OF1)
+    QUICK_CJMP(QUICK_NAME_OF1)
+    QUICK_CAST(QUICK_NAME_OFC)
+    QUICK_CMPJ(QUICK_NAME_OFJ)
+    QUICK_CMPJ(QUICK_NAME_OFIJ)
+    QUICK_SCALE(QUICK_NAME_OF1)
+    QUICK_MEMB(QUICK_NAME_OF1)
+
+    #undef QUICK_NAME_OF
+    #undef QUICK_NAME_OFIJ
+    #undef QUICK_NAME_OFJ
+    #undef QUICK_NAME_OFC
+    #undef QUICK_NAME_OF1
+    #undef QUICK_NAME_OF2
+    #undef NAME_OF
+};
 
-    case CODEGEN_OP_INCP:
-    case CODEGEN_OP_DECP:
-        result = insn_incp_decp(insn);
-        break;
+static uint64_t (*pair_counts)[EXEC_OP_COUNT];
+static exec_op_t last_op;
 
-    case CODEGEN_OP_JZ:
-    case CODEGEN_OP_JNZ:
-        result = insn_cjmp(insn);
-        break;
+struct pair_count {
+    uint64_t count;
+    exec_op_t first, second;
+};
 
-    case CODEGEN_OP_JMP:
-        result = insn_jmp(insn);
-        break;
+static int pair_count_cmp(const void *const lhs, const void *const rhs)
+{
+    const uint64_t lcount = ((const struct pair_count *) lhs)->count;
+    const uint64_t rcount = ((const struct pair_count *) rhs)->count;
+    return lcount < rcount ? 1 : lcount > rcount ? -1 : 0;
+}
 
-    case CODEGEN_OP_PUSHR:
-        result = insn_pushr(insn);
-        break;
+static void print_pair_stats(void)
+{
+    struct pair_count top[PAIR_STATS_TOP + 1];
+    size_t top_count = 0;
+    uint64_t total = 0;
 
-    case CODEGEN_OP_PUSH:
-        result = insn_push(insn);
-        break;
+    for (size_t first = 0; first < EXEC_OP_COUNT; ++first) {
+        for (size_t second = 0; second < EXEC_OP_COUNT; ++second) {
+            const uint64_t count = pair_counts[first][second];
 
-    case CODEGEN_OP_CALL:
-    case CODEGEN_OP_CALLV:
-        result = insn_call_callv(insn);
-        break;
+            if (!count) {
+                continue;
+            }
 
-    case CODEGEN_OP_INCSP:
-        result = insn_incsp(insn);
-        break;
+            total += count;
 
-    case CODEGEN_OP_RET:
-    case CODEGEN_OP_RETV:
-        result = insn_ret_retv(insn);
-        break;
+            if (top_count == PAIR_STATS_TOP && count <= top[top_count - 1].count) {
+                continue;
+            }
 
-    case CODEGEN_OP_REF:
-        result = insn_ref(insn);
-        break;
+            top[top_count < PAIR_STATS_TOP ? top_count++ : top_count - 1] =
+                (struct pair_count) { count, first, second };
 
-    case CODEGEN_OP_DRF:
-        result = insn_drf(insn);
-        break;
+            qsort(top, top_count, sizeof(*top), pair_count_cmp);
+        }
+    }
 
-    case CODEGEN_OP_RTE:
-    case CODEGEN_OP_RTEV:
-        result = insn_rte_rtev(insn);
-        break;
+    fprintf(stderr, "%" PRIu64 " instruction pairs, the most frequent:\n", total);
 
-    case CODEGEN_OP_QAT:
-        result = insn_qat(insn);
-        break;
+    for (size_t idx = 0; idx < top_count; ++idx) {
+        fprintf(stderr, "%12" PRIu64 " %5.2f%%  %s %s\n", top[idx].count,
+            100.0 * (double) top[idx].count / (double) total,
+            op_names[top[idx].first], op_names[top[idx].second]);
+    }
+}
 
-    case CODEGEN_OP_WAIT:
-        result = insn_wait(insn);
-        break;
+#define COUNT_PAIR(op) \
+    pair_counts[last_op][op]++, last_op = (op)
+#else
+#define COUNT_PAIR(op) ((void) 0)
+#endif
 
-    case CODEGEN_OP_WLAB:
-        result = insn_wlab(insn);
-        break;
+/* the address of a quickened operand of the given kind, see run() */
+#define QUICK_T(off) (tp + (off))
+#define QUICK_A(off) (fp + (off))
+#define QUICK_G(off) (dp + (off))
+#define QUICK_AT(kind, off) QUICK_##kind(off)
 
-    case CODEGEN_OP_GETSP:
-        result = insn_getsp(insn);
-        break;
+static void prepare(void)
+{
+    for (size_t idx = 0; idx < o->insn_count; ++idx) {
+        insns[idx].quick = quicken(&insns[idx]);
+    }
 
-    case CODEGEN_OP_QNT:
-        result = insn_qnt(insn);
-        break;
+    for (size_t idx = 0; idx < o->insn_count; ++idx) {
+        insns[idx].quick = fuse(idx);
+    }
 
-    case CODEGEN_OP_QNTV:
-        result = insn_qntv(insn);
-        break;
+    /* falling through past the last instruction ends the program */
+    insns[o->insn_count].quick = EXEC_OP_halt;
+}
 
-    case CODEGEN_OP_NOINT:
-    case CODEGEN_OP_INT:
-        result = insn_noint_int(insn);
-        break;
+#ifdef EXEC_THREADED
+/* the handler addresses of the instructions, set up by the first run() */
+static const void **code;
+#endif
 
-    case CODEGEN_OP_BFUN:
-        result = insn_bfun(insn);
-        break;
+/* runs the current VM, see prepare() */
+static int run(void)
+{
+    /*
+     * The state of the running VM the quickened handlers need is kept in
+     * locals: the instruction pointer, the frame (autos), the temporaries
+     * and the data segment (globals, which the verifier has checked to lie
+     * within it). It is written back before a generic handler runs and
+     * reloaded after it, as well as when another VM takes over.
+     */
+    const struct exec_insn *insn;
+    const uint64_t insn_count = o->insn_count;
+    uint8_t *const dp = bss;
+    uint8_t *fp, *tp;
+    uint64_t ip;
+    bool may_split;
+    int result = EXEC_OK;
 
-    default: LEGAL_IF(false, "unknown instruction: %u", insn->op);
+#ifdef CODEGEN_HEAP_TEMPS
+    #define TEMPS_BASE() (vm->temps ? vm->temps->mem : NULL)
+#else
+    #define TEMPS_BASE() fp
+#endif
+
+    #define RELOAD() \
+        ip = vm->ip; \
+        fp = vm->stack + vm->bp; \
+        tp = TEMPS_BASE(); \
+        may_split = vm->may_split
+
+    RELOAD();
+
+#ifdef EXEC_THREADED
+    /*
+     * Direct-threaded dispatch: every instruction is pre-decoded into the
+     * address of its handler, so that each handler jumps straight to the next
+     * one instead of going back through a central switch.
+     */
+    #define LABEL_OF(name) [EXEC_OP_##name] = &&op_##name,
+    #define QUICK_LABEL2(...) QUICK_LABEL(QUICK_NAME2(__VA_ARGS__))
+    #define QUICK_LABEL1(...) QUICK_LABEL(QUICK_NAME1(__VA_ARGS__))
+    #define QUICK_LABELC(...) QUICK_LABEL(QUICK_NAMEC(__VA_ARGS__))
+    #define QUICK_LABELJ(...) QUICK_LABEL(QUICK_NAMEJ(__VA_ARGS__))
+    #define QUICK_LABELIJ(...) QUICK_LABEL(QUICK_NAMEIJ(__VA_ARGS__))
+    #define QUICK_LABEL(name) LABEL_OF(name)
+
+    static const void *const handlers[EXEC_OP_COUNT] = {
+        EXEC_GENERIC_OPS(LABEL_OF)
+        QUICK_BIN(QUICK_LABEL2)
+        QUICK_CMP(QUICK_LABEL2)
+        QUICK_MOV(QUICK_LABEL2)
+        QUICK_UN(QUICK_LABEL1)
+        QUICK_OZ(QUICK_LABEL1)
+        QUICK_INCP(QUICK_LABEL1)
+        QUICK_INC(QUICK_LABEL1)
+        QUICK_LDI(QUICK_LABEL1)
+        QUICK_CJMP(QUICK_LABEL1)
+        QUICK_CAST(QUICK_LABELC)
+        QUICK_CMPJ(QUICK_LABELJ)
+        QUICK_CMPJ(QUICK_LABELIJ)
+        QUICK_SCALE(QUICK_LABEL1)
+        QUICK_MEMB(QUICK_LABEL1)
+    };
+
+    #undef QUICK_LABEL
+    #undef QUICK_LABELIJ
+    #undef QUICK_LABELJ
+    #undef QUICK_LABELC
+    #undef QUICK_LABEL1
+    #undef QUICK_LABEL2
+    #undef LABEL_OF
+
+    /* spawned quaints only run once the main thread is running */
+    if (unlikely(!code)) {
+        if (unlikely(!(code = malloc((o->insn_count + 1) * sizeof(*code))))) {
+            return EXEC_NOMEM;
+        }
+
+        for (size_t idx = 0; idx <= o->insn_count; ++idx) {
+            code[idx] = handlers[insns[idx].quick];
+        }
     }
 
-    switch (insn->op) {
-    case CODEGEN_OP_JZ:
-    case CODEGEN_OP_JNZ:
-    case CODEGEN_OP_JMP:
-    case CODEGEN_OP_CALL:
-    case CODEGEN_OP_CALLV:
-    case CODEGEN_OP_RET:
-    case CODEGEN_OP_RETV:
-    case CODEGEN_OP_BFUN:
-    case CODEGEN_OP_RTE:
-    case CODEGEN_OP_RTEV:
-    case CODEGEN_OP_WAIT:
-        break;
+    #define OPCODE_(name) op_##name
+    #define NEXT \
+        insn = &insns[ip]; \
+        COUNT_PAIR(insn->quick); \
+        goto *code[ip]
+#else
+    #define OPCODE_(name) case EXEC_OP_##name
+    #define NEXT goto dispatch
+#endif
 
-    default:
-        vm->ip++;
+    #define OPCODE(name) OPCODE_(name)
+
+    /* for an instruction pointer taken from the machine state */
+    #define CHECKED_NEXT \
+        if (unlikely(ip >= insn_count)) { \
+            goto end; \
+        } \
+        \
+        NEXT
+
+    /*
+     * Only at safepoints (jumps, calls, returns, waits, wait labels and the
+     * end of noint blocks) is it checked whether a waiting ancestor is to
+     * take over, and only if one waits for a wait label or a deadline has
+     * passed. Between two safepoints, there can be no loop and no passed
+     * wait label.
+     */
+    #define SAFEPOINT() \
+        if (unlikely(may_split || deadline_passed)) { \
+            struct qvm *const next_vm = check_and_eventually_split_vms(); \
+            \
+            if (next_vm) { \
+                vm->ip = ip; \
+                vm = next_vm; \
+                RELOAD(); \
+            } \
+        }
+
+    /* the handler has already moved the instruction pointer */
+    #define JUMPED(handler) \
+        vm->ip = ip; \
+        \
+        if (unlikely((result = (handler)))) { \
+            goto out; \
+        } \
+        \
+        RELOAD(); \
+        SAFEPOINT(); \
+        CHECKED_NEXT
+
+    /* the handler falls through to the following instruction */
+    #define ADVANCE(handler) \
+        vm->ip = ip; \
+        \
+        if (unlikely((result = (handler)))) { \
+            goto out; \
+        } \
+        \
+        RELOAD(); \
+        ip++; \
+        NEXT
+
+    /* the same, then a safepoint */
+    #define ADVANCE_SAFEPOINT(handler) \
+        vm->ip = ip; \
+        \
+        if (unlikely((result = (handler)))) { \
+            goto out; \
+        } \
+        \
+        RELOAD(); \
+        ip++; \
+        SAFEPOINT(); \
+        NEXT
+
+    if (unlikely(ip >= insn_count)) {
+        goto end;
+    }
+
+#ifdef EXEC_THREADED
+    NEXT;
+#else
+dispatch:
+    insn = &insns[ip];
+    COUNT_PAIR(insn->quick);
+
+    switch (insn->quick) {
+#endif
+
+    OPCODE(nop):        ip++; NEXT;
+    OPCODE(mov):        ADVANCE(insn_mov(insn));
+    OPCODE(cast):       ADVANCE(insn_cast(insn));
+    OPCODE(bin_arith):  ADVANCE(insn_bin_arith(insn));
+    OPCODE(equ_neq):    ADVANCE(insn_equ_neq(insn));
+    OPCODE(bin_logic):  ADVANCE(insn_bin_logic(insn));
+    OPCODE(not):        ADVANCE(insn_not(insn));
+    OPCODE(neg):        ADVANCE(insn_neg(insn));
+    OPCODE(bneg):       ADVANCE(insn_bneg(insn));
+    OPCODE(oz):         ADVANCE(insn_oz(insn));
+    OPCODE(inc_dec):    ADVANCE(insn_inc_dec(insn));
+    OPCODE(incp_decp):  ADVANCE(insn_incp_decp(insn));
+    OPCODE(cjmp):       JUMPED(insn_cjmp(insn));
+    OPCODE(jmp):        JUMPED(insn_jmp(insn));
+    OPCODE(pushr):      ADVANCE(insn_pushr(insn));
+    OPCODE(push):       ADVANCE(insn_push(insn));
+    OPCODE(call_callv): JUMPED(insn_call_callv(insn));
+    OPCODE(incsp):      ADVANCE(insn_incsp(insn));
+    OPCODE(ret_retv):   JUMPED(insn_ret_retv(insn));
+    OPCODE(ref):        ADVANCE(insn_ref(insn));
+    OPCODE(drf):        ADVANCE(insn_drf(insn));
+    OPCODE(rte_rtev):   JUMPED(insn_rte_rtev(insn));
+    OPCODE(qat):        ADVANCE(insn_qat(insn));
+    OPCODE(wait):       JUMPED(insn_wait(insn));
+    OPCODE(wlab):       ADVANCE_SAFEPOINT(insn_wlab(insn));
+    OPCODE(getsp):      ADVANCE(insn_getsp(insn));
+    OPCODE(qnt):        ADVANCE(insn_qnt(insn));
+    OPCODE(qntv):       ADVANCE(insn_qntv(insn));
+    OPCODE(noint_int):  ADVANCE_SAFEPOINT(insn_noint_int(insn));
+    OPCODE(bfun):       JUMPED(insn_bfun(insn));
+    OPCODE(halt):       goto end;
+
+    #define BIN_HANDLER(name, op, ty, type, k1, k2) \
+    OPCODE(QUICK_NAME2(name, op, ty, type, k1, k2)): \
+        *(type *) QUICK_T(insn->bin.dst.off) = (type) \
+            (*(type *) QUICK_AT(k1, insn->bin.src1.off) op \
+            *(type *) QUICK_AT(k2, insn->bin.src2.off)); \
+        \
+        ip++; \
+        NEXT;
+
+    #define CMP_HANDLER(name, op, ty, type, k1, k2) \
+    OPCODE(QUICK_NAME2(name, op, ty, type, k1, k2)): \
+        *(uint8_t *) QUICK_T(insn->bin.dst.off) = \
+            *(type *) QUICK_AT(k1, insn->bin.src1.off) op \
+            *(type *) QUICK_AT(k2, insn->bin.src2.off); \
+        \
+        ip++; \
+        NEXT;
+
+    #define MOV_HANDLER(name, op, ty, type, k1, k2) \
+    OPCODE(QUICK_NAME2(name, op, ty, type, k1, k2)): \
+        *(type *) QUICK_AT(k1, insn->un.dst.off) op \
+            *(type *) QUICK_AT(k2, insn->un.src.off); \
+        \
+        ip++; \
+        NEXT;
+
+    #define UN_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): \
+        *(type *) QUICK_T(insn->un.dst.off) = \
+            (type) op *(type *) QUICK_AT(k, insn->un.src.off); \
+        \
+        ip++; \
+        NEXT;
+
+    #define OZ_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): \
+        *(uint8_t *) QUICK_T(insn->un.dst.off) = \
+            op *(type *) QUICK_AT(k, insn->un.src.off); \
+        \
+        ip++; \
+        NEXT;
+
+    #define INCP_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): \
+        *(type *) QUICK_T(insn->un.dst.off) = \
+            (*(type *) QUICK_AT(k, insn->un.src.off))op; \
+        \
+        ip++; \
+        NEXT;
+
+    #define INC_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): \
+        (*(type *) QUICK_AT(k, insn->dst.off))op; \
+        ip++; \
+        NEXT;
+
+    #define LDI_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): \
+        *(type *) QUICK_AT(k, insn->un.dst.off) op (type) imms[insn->un.src.off]; \
+        ip++; \
+        NEXT;
+
+    #define CJMP_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): \
+        ip = *(type *) QUICK_AT(k, insn->jmp.cond.off) op 0 ? \
+            insn->jmp.loc : ip + 1; \
+        \
+        SAFEPOINT(); \
+        NEXT;
+
+    #define CAST_HANDLER(name, op, dty, dtype, sty, stype, k) \
+    OPCODE(QUICK_NAMEC(name, op, dty, dtype, sty, stype, k)): \
+        *(dtype *) QUICK_T(insn->un.dst.off) op \
+            (dtype) *(stype *) QUICK_AT(k, insn->un.src.off); \
+        \
+        ip++; \
+        NEXT;
+
+    QUICK_BIN(BIN_HANDLER)
+    QUICK_CMP(CMP_HANDLER)
+    QUICK_MOV(MOV_HANDLER)
+    QUICK_UN(UN_HANDLER)
+    QUICK_OZ(OZ_HANDLER)
+    QUICK_INCP(INCP_HANDLER)
+    QUICK_INC(INC_HANDLER)
+    QUICK_LDI(LDI_HANDLER)
+    QUICK_CJMP(CJMP_HANDLER)
+    QUICK_CAST(CAST_HANDLER)
+
+    /* also jumped to by LDI_CMPJ_HANDLER, past the load of the literal */
+    #define CMPJ_BODY(name) CMPJ_BODY_(name)
+    #define CMPJ_BODY_(name) body_##name
+
+    #define CMPJ_HANDLER(name, cmp, ty, type, k) \
+    OPCODE(QUICK_NAMEJ(name, cmp, ty, type, k)): \
+    CMPJ_BODY(QUICK_NAMEJ(name, cmp, ty, type, k)): { \
+        const uint8_t cond = *(uint8_t *) QUICK_T(insn->bin.dst.off) = \
+            *(type *) QUICK_AT(k, insn->bin.src1.off) cmp \
+            *(type *) QUICK_T(insn->bin.src2.off); \
+        \
+        const struct exec_insn *const branch = insn + 1; \
+        ip = (cond != 0) == (branch->op == CODEGEN_OP_JNZ) ? \
+            branch->jmp.loc : ip + 2; \
+    } \
+    SAFEPOINT(); \
+    NEXT;
+
+    #define LDI_CMPJ_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAMEIJ(name, op, ty, type, k)): \
+        *(type *) QUICK_T(insn->un.dst.off) = (type) imms[insn->un.src.off]; \
+        insn++; \
+        ip++; \
+        goto CMPJ_BODY(QUICK_NAMEJ(name, op, ty, type, k));
+
+    #define SCALE_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): \
+        *(uint64_t *) QUICK_T(insn->un.dst.off) = \
+            (uint64_t) *(type *) QUICK_AT(k, insn->un.src.off) op \
+            imms[insn[1].bin.src2.off]; \
+        \
+        ip += 2; \
+        NEXT;
+
+    #define MEMB_HANDLER(name, op, ty, type, k) \
+    OPCODE(QUICK_NAME1(name, op, ty, type, k)): { \
+        const type ptr = *(type *) (uintptr_t) *(type *) QUICK_AT(k, insn->un.src.off); \
+        *(type *) QUICK_T(insn->un.dst.off) = ptr; \
+        *(type *) QUICK_T(insn[1].bin.dst.off) = ptr op imms[insn[1].bin.src2.off]; \
+        ip += 2; \
+    } \
+    NEXT;
+
+    QUICK_CMPJ(CMPJ_HANDLER)
+    QUICK_CMPJ(LDI_CMPJ_HANDLER)
+    QUICK_SCALE(SCALE_HANDLER)
+    QUICK_MEMB(MEMB_HANDLER)
+
+    #undef MEMB_HANDLER
+    #undef SCALE_HANDLER
+    #undef LDI_CMPJ_HANDLER
+    #undef CMPJ_HANDLER
+    #undef CMPJ_BODY_
+    #undef CMPJ_BODY
+    #undef CAST_HANDLER
+    #undef CJMP_HANDLER
+    #undef LDI_HANDLER
+    #undef INC_HANDLER
+    #undef INCP_HANDLER
+    #undef OZ_HANDLER
+    #undef UN_HANDLER
+    #undef MOV_HANDLER
+    #undef CMP_HANDLER
+    #undef BIN_HANDLER
+
+#ifndef EXEC_THREADED
+    }
+#endif
+
+    #undef ADVANCE_SAFEPOINT
+    #undef ADVANCE
+    #undef JUMPED
+    #undef SAFEPOINT
+    #undef CHECKED_NEXT
+    #undef OPCODE
+    #undef NEXT
+    #undef OPCODE_
+    #undef RELOAD
+    #undef TEMPS_BASE
+
+end:
+    vm->ip = ip;
+
+    if (unlikely(ip > insn_count)) {
+        fprintf(stderr, "%s:%d: illegal instruction pointer: %" PRIu64 "\n",
+            __FILE__, __LINE__, ip);
+
+        result = EXEC_ILLEGAL;
     }
 
-    check_and_eventually_split_vms();
+out:
     return result;
 }
 
@@ -1690,7 +5946,7 @@ int exec(const struct codegen_obj *const obj)
         return EXEC_NOMEM;
     }
 
-    if (!(vm = calloc(1, sizeof(struct qvm) + STACK_SIZE))) {
+    if (!(vm = alloc_vm(0))) {
         free(bss);
         return EXEC_NOMEM;
     }
@@ -1705,17 +5961,75 @@ int exec(const struct codegen_obj *const obj)
     vm->ip = SCOPE_BFUN_ID_COUNT;
 
     o = obj;
-    int error;
+    int error = encode();
 
-    do {
-        if ((error = exec_insn(&o->insns[vm->ip]))) {
-            break;
-        }
+    if (!error) {
+        error = verify();
+    }
+
+#ifdef EXEC_PAIR_STATS
+    if (!error && !(pair_counts = calloc(EXEC_OP_COUNT, sizeof(*pair_counts)))) {
+        error = EXEC_NOMEM;
+    }
+#endif
+
+    struct sigaction action = { .sa_handler = deadline_handler, .sa_flags = SA_RESTART };
+    sigemptyset(&action.sa_mask);
 
-        LEGAL_IF(vm->ip <= o->insn_count, "%" PRIu64, vm->ip);
-    } while (vm->ip < o->insn_count);
+    if (!error && sigaction(SIGALRM, &action, NULL)) {
+        perror("sigaction");
+        error = EXEC_NOMEM;
+    }
+
+    if (!error) {
+        prepare();
+        error = run();
+        arm_deadline(0);
+    }
+
+    flush_output();
+
+#ifdef EXEC_TASKS
+    /* the program ends with its entry, with no wait for the tasks nobody reaped */
+    if (!stop_tasks()) {
+        exit(error);
+    }
+#endif
+
+#ifdef EXEC_PAIR_STATS
+    if (!error) {
+        print_pair_stats();
+    }
+
+    free(pair_counts);
+#endif
+
+#ifdef EXEC_THREADED
+    free(code);
+    code = NULL;
+#endif
+    free(labels);
+    free(imms);
+    free(insns);
+#ifdef EXEC_RECLAIM
+    const uint64_t unreaped = count_owned(vm);
+
+    if (reclaimed || unreaped) {
+        fprintf(stderr, "quaints: %" PRIu64 " reclaimed, %" PRIu64 " never reaped\n",
+            reclaimed, unreaped);
+    }
 
-    free(vm);
+    free_owned(vm);
+    free(orphans);
+#endif
+    free_vm(vm);
+    stop_workers();
+    free_fd_buffers();
+    free_reactor();
+#ifdef EXEC_QVM_STATS
+    print_pool_stats();
+#endif
+    drain_pool();
     free(bss);
     return error;
 }
@@ -294,12 +294,14 @@ TOKEN_DEFINE_6(tk_szof, "sizeof")
 TOKEN_DEFINE_7(tk_alof, "alignof")
 
 TOKEN_DEFINE_4(tk_wait, "wait")
+TOKEN_DEFINE_3(tk_wany, "any")
 TOKEN_DEFINE_3(tk_wfor, "for")
 TOKEN_DEFINE_5(tk_wunt, "until")
 TOKEN_DEFINE_7(tk_wnob, "noblock")
 TOKEN_DEFINE_4(tk_wmse, "msec")
 TOKEN_DEFINE_3(tk_wsec, "sec")
 TOKEN_DEFINE_5(tk_noin, "noint")
+TOKEN_DEFINE_5(tk_spwn, "spawn")
 
 TOKEN_DEFINE_1(tk_scol, ";")
 
@@ -378,12 +380,14 @@ static sts_t (*const tk_funcs[])(const uint8_t, uint8_t *const) = {
     tk_alof,
 
     tk_wait,
+    tk_wany,
     tk_wfor,
     tk_wunt,
     tk_wnob,
     tk_wmse,
     tk_wsec,
     tk_noin,
+    tk_spwn,
 
     tk_scol,
 
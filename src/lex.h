@@ -77,12 +77,14 @@ enum {
     LEX_TK_ALOF, // (unary) alignment of type
 
     LEX_TK_WAIT, // wait keyword
+    LEX_TK_WANY, // any keyword
     LEX_TK_WFOR, // for keyword
     LEX_TK_WUNT, // until keyword
     LEX_TK_WNOB, // noblock keyword
     LEX_TK_WMSE, // msec keyword
     LEX_TK_WSEC, // sec keyword
     LEX_TK_NOIN, // noint keyword
+    LEX_TK_SPWN, // spawn keyword
 
     LEX_TK_SCOL, // semicolon statement separator
 
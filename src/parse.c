@@ -73,6 +73,13 @@ static const struct rule grammar[] = {
     r6(Stmt, t(WAIT), n(Expr), t(WUNT), n(Expr), t(WNOB), t(SCOL)              )
     r3(Stmt, t(WAIT), n(Expr), t(SCOL)                                         )
     r4(Stmt, t(WAIT), n(Expr), t(WNOB), t(SCOL)                                )
+    r6(Stmt, t(WAIT), t(WANY), n(Expr), t(WFOR), n(Expr), t(SCOL)              )
+    r7(Stmt, t(WAIT), t(WANY), n(Expr), t(WFOR), n(Expr), t(WNOB), t(SCOL)     )
+    r6(Stmt, t(WAIT), t(WANY), n(Expr), t(WUNT), n(Expr), t(SCOL)              )
+    r7(Stmt, t(WAIT), t(WANY), n(Expr), t(WUNT), n(Expr), t(WNOB), t(SCOL)     )
+    r4(Stmt, t(WAIT), t(WANY), n(Expr), t(SCOL)                                )
+    r5(Stmt, t(WAIT), t(WANY), n(Expr), t(WNOB), t(SCOL)                       )
+    r3(Stmt, t(SPWN), n(Expr), t(SCOL)                                         )
     r3(Stmt, t(RETN), n(Expr), t(SCOL)                                         )
     r2(Stmt, t(RETN), t(SCOL)                                                  )
     r3(Stmt, t(USEU), n(Expr), t(SCOL)                                         )
@@ -267,6 +267,455 @@ const struct scope_builtin_func scope_builtin_funcs[] = {
             }
         )
     },
+
+    {
+        .name = lex_sym("waited"),
+        .rettype = type(U32, 1),
+        .param_count = 0,
+        .params = NULL,
+    },
+
+    {
+        .name = lex_sym("read"),
+        .rettype = type(SSIZE, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fd"),
+                .type = type(I32, 1),
+            },
+            {
+                .name = lex_sym("buf"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("write"),
+        .rettype = type(SSIZE, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fd"),
+                .type = type(I32, 1),
+            },
+            {
+                .name = lex_sym("buf"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("accept"),
+        .rettype = type(I32, 1),
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fd"),
+                .type = type(I32, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("close"),
+        .rettype = type(I32, 1),
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fd"),
+                .type = type(I32, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("pipe"),
+        .rettype = type(I32, 1),
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fds"),
+                .type = type_ptr(1, type(I32, 1)),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("listen"),
+        .rettype = type(I32, 1),
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("path"),
+                .type = type_ptr(1, type(U8, 1)),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("connect"),
+        .rettype = type(I32, 1),
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("path"),
+                .type = type_ptr(1, type(U8, 1)),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("ncpus"),
+        .rettype = type(U32, 1),
+        .param_count = 0,
+        .params = NULL,
+    },
+
+    {
+        .name = lex_sym("workers"),
+        .rettype = type(U32, 1),
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("count"),
+                .type = type(U32, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("send"),
+        .rettype = type(I32, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("to"),
+                .type = type(U32, 1),
+            },
+            {
+                .name = lex_sym("msg"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("recv"),
+        .rettype = type(SSIZE, 1),
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("buf"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("save"),
+        .rettype = type(I32, 1),
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("quaint"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("path"),
+                .type = type_ptr(1, type(U8, 1)),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("restore"),
+        .rettype = type(I32, 1),
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("quaint"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("path"),
+                .type = type_ptr(1, type(U8, 1)),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("flush"),
+        .rettype = NULL,
+        .param_count = 0,
+        .params = NULL
+    },
+
+    {
+        .name = lex_sym("pf"),
+        .rettype = NULL,
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fmt"),
+                .type = type_ptr(1, type(U8, 1)),
+            },
+            {
+                .name = lex_sym("args"),
+                .type = type(VPTR, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("memcpy"),
+        .rettype = type(VPTR, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("dst"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("src"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("memset"),
+        .rettype = type(VPTR, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("dst"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("byte"),
+                .type = type(U8, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("memcmp"),
+        .rettype = type(I32, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("a"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("b"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("memchr"),
+        .rettype = type(VPTR, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("buf"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("byte"),
+                .type = type(U8, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("strlen"),
+        .rettype = type(USIZE, 1),
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("str"),
+                .type = type_ptr(1, type(U8, 1)),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("open"),
+        .rettype = type(I32, 1),
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("path"),
+                .type = type_ptr(1, type(U8, 1)),
+            },
+            {
+                .name = lex_sym("mode"),
+                .type = type(U32, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("mmap"),
+        .rettype = type_ptr(1, type(U8, 1)),
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fd"),
+                .type = type(I32, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type_ptr(1, type(USIZE, 1)),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("munmap"),
+        .rettype = type(I32, 1),
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("mem"),
+                .type = type_ptr(1, type(U8, 1)),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("bwrite"),
+        .rettype = type(SSIZE, 1),
+        .param_count = 3,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("fd"),
+                .type = type(I32, 1),
+            },
+            {
+                .name = lex_sym("buf"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("arena"),
+        .rettype = type(VPTR, 1),
+        .param_count = 0,
+        .params = NULL,
+    },
+
+    {
+        .name = lex_sym("aalloc"),
+        .rettype = type(VPTR, 1),
+        .param_count = 2,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("arena"),
+                .type = type(VPTR, 1),
+            },
+            {
+                .name = lex_sym("size"),
+                .type = type(USIZE, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("areset"),
+        .rettype = NULL,
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("arena"),
+                .type = type(VPTR, 1),
+            }
+        )
+    },
+
+    {
+        .name = lex_sym("afree"),
+        .rettype = NULL,
+        .param_count = 1,
+        .params = PARAMS
+        (
+            {
+                .name = lex_sym("arena"),
+                .type = type(VPTR, 1),
+            }
+        )
+    },
 };
 
 #undef PARAMS
@@ -57,6 +57,35 @@ enum {
     SCOPE_BFUN_ID_PI64,
     SCOPE_BFUN_ID_PNL,
     SCOPE_BFUN_ID_EXIT,
+    SCOPE_BFUN_ID_WAITED,
+    SCOPE_BFUN_ID_READ,
+    SCOPE_BFUN_ID_WRITE,
+    SCOPE_BFUN_ID_ACCEPT,
+    SCOPE_BFUN_ID_CLOSE,
+    SCOPE_BFUN_ID_PIPE,
+    SCOPE_BFUN_ID_LISTEN,
+    SCOPE_BFUN_ID_CONNECT,
+    SCOPE_BFUN_ID_NCPUS,
+    SCOPE_BFUN_ID_WORKERS,
+    SCOPE_BFUN_ID_SEND,
+    SCOPE_BFUN_ID_RECV,
+    SCOPE_BFUN_ID_SAVE,
+    SCOPE_BFUN_ID_RESTORE,
+    SCOPE_BFUN_ID_FLUSH,
+    SCOPE_BFUN_ID_PF,
+    SCOPE_BFUN_ID_MEMCPY,
+    SCOPE_BFUN_ID_MEMSET,
+    SCOPE_BFUN_ID_MEMCMP,
+    SCOPE_BFUN_ID_MEMCHR,
+    SCOPE_BFUN_ID_STRLEN,
+    SCOPE_BFUN_ID_OPEN,
+    SCOPE_BFUN_ID_MMAP,
+    SCOPE_BFUN_ID_MUNMAP,
+    SCOPE_BFUN_ID_BWRITE,
+    SCOPE_BFUN_ID_ARENA,
+    SCOPE_BFUN_ID_AALLOC,
+    SCOPE_BFUN_ID_ARESET,
+    SCOPE_BFUN_ID_AFREE,
     SCOPE_BFUN_ID_COUNT,
 };
 
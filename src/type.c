@@ -1795,12 +1795,25 @@ static int check_wait(const struct ast_node *const stmt,
 {
     int error = TYPE_OK;
     struct ast_wait *const wait = ast_data(stmt, wait);
-    const struct type *const wtype = type_from_expr(wait->wquaint, scope);
+    const struct ast_node *wlist = wait->wquaint;
 
-    if (!wtype) {
-        error = TYPE_INVALID;
-    } else if (wtype->t != TYPE_QUAINT) {
-        error = INVALID("wait needs quaint type", wait->wquaint);
+    /* the quaints of a wait-any are a comma list, checked one by one */
+    while (wlist) {
+        const uint8_t not_last = wait->any && wlist->an == AST_AN_BEXP &&
+            ast_data(wlist, bexp)->op == LEX_TK_COMA;
+
+        const struct ast_node *const wquaint = not_last ?
+            ast_data(wlist, bexp)->lhs : wlist;
+
+        wlist = not_last ? ast_data(wlist, bexp)->rhs : NULL;
+        const struct type *const wtype = type_from_expr(wquaint, scope);
+
+        if (!wtype) {
+            error = TYPE_INVALID;
+        } else if (wtype->t != TYPE_QUAINT) {
+            error = wait->spawn ? INVALID("spawn needs quaint type", wquaint) :
+                INVALID("wait needs quaint type", wquaint);
+        }
     }
 
     if (wait->wfor) {